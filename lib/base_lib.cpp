@@ -1,16 +1,283 @@
 #include "base_lib.h"
+#include <algorithm>
 
+const int B2N_CUTOFF = 32; //Below this many digits a plain Horner loop is quicker than splitting
 
-void b2n(std::vector<uint8_t>& digits, int base, std::vector<int>& countsOut, fmpz_t nOut) {
+
+int power_tree_levels(int len) {
+	//Number of levels needed so that the top split of a block of 'len' digits is covered
+	int levels = 1;
+	while ((1 << levels) < len) levels++;
+	return levels;
+}
+
+void gen_power_tree(int base, int len, fmpz_mat_t treeOut) {
+	//Generates the powers base^(2^j) used to join the halves of a divide-and-conquer conversion.
+	//Note: This only depends on the base and block length, so it can be generated once
+	//and reused for every block of the same length
+	int levels = power_tree_levels(len);
+	fmpz_mat_init(treeOut, 1, levels);
+	
+	fmpz_set_ui(fmpz_mat_entry(treeOut, 0, 0), base);
+	for (int j = 1; j < levels; j++) {
+		fmpz_mul(
+			fmpz_mat_entry(treeOut, 0, j),
+			fmpz_mat_entry(treeOut, 0, j-1),
+			fmpz_mat_entry(treeOut, 0, j-1)
+		);
+	}
+	//Don't forget to call fmpz_mat_clear(tree);
+}
+
+template <typename T>
+void b2n_recur(const T* digits, int len, int base, fmpz_mat_t tree, fmpz_t nOut) {
+	//Note: Digits are allowed to be bigger than the base (see b2n_ui)
+	if (len <= B2N_CUTOFF) { //Anchor
+		fmpz_zero(nOut);
+		for (int i = len-1; i >= 0; i--) {
+			fmpz_mul_ui(nOut, nOut, base);
+			fmpz_add_ui(nOut, nOut, digits[i]);
+		}
+		return;
+	}
+	
+	//Split on the largest power of two below len, so that the low half always has a cached power
+	int level = power_tree_levels(len) - 1;
+	int half = 1 << level;
+	
+	fmpz_t hi;
+	fmpz_init(hi);
+	b2n_recur(digits + half, len - half, base, tree, hi);
+	b2n_recur(digits, half, base, tree, nOut);
+	
+	//n = lo + hi * base^half
+	fmpz_addmul(nOut, hi, fmpz_mat_entry(tree, 0, level));
+	fmpz_clear(hi);
+}
+
+int pow2_digit_bits(int base) {
+	//Bits per digit for the power-of-two bases whose digits pack evenly into a limb, otherwise 0
+	switch (base) {
+		case 2: return 1;
+		case 4: return 2;
+		case 16: return 4;
+		case 256: return 8;
+		case 65536: return 16; //(uint16_t digits)
+		default: return 0;
+	}
+}
+
+template <typename Sym>
+void b2n_pow2(std::vector<Sym>& digits, int bits, std::vector<int>& countsOut, fmpz_t nOut) {
+	//For power-of-two bases the number is just the digits bit-packed together,
+	//so they are written straight into the limbs with no bignum arithmetic
+	int len = digits.size();
+	int digitsPerLimb = FLINT_BITS / bits;
+	int limbCount = (len + digitsPerLimb - 1) / digitsPerLimb;
 	fmpz_zero(nOut);
-	for (int i = 0; i < (int)digits.size(); i++) {
-		uint8_t digit = digits[i];
-		fmpz_t power;
-		fmpz_init(power);
-		fmpz_ui_pow_ui(power, base, i);
-		fmpz_addmul_ui(nOut, power, digit);
-		fmpz_clear(power);
-		countsOut[digit]++;
+	if (limbCount == 0) return;
+	
+	mpz_ptr z = _fmpz_promote(nOut);
+	mp_limb_t* limbs = mpz_limbs_write(z, limbCount);
+	const Sym* d = digits.data();
+	for (int l = 0; l < limbCount; l++) {
+		int start = l * digitsPerLimb;
+		int end = std::min(start + digitsPerLimb, len);
+		mp_limb_t limb = 0;
+		for (int i = start; i < end; i++) {
+			limb |= (mp_limb_t)d[i] << (bits * (i - start));
+			countsOut[d[i]]++; //Build the histogram in the same pass
+		}
+		limbs[l] = limb;
+	}
+	mpz_limbs_finish(z, limbCount); //Also normalizes away any high zero limbs
+	_fmpz_demote_val(nOut); //Small values must be stored inline
+}
+
+template <typename Sym>
+void b2n(std::vector<Sym>& digits, int base, std::vector<int>& countsOut, fmpz_t nOut) {
+	int bits = pow2_digit_bits(base);
+	if (bits > 0) {
+		b2n_pow2(digits, bits, countsOut, nOut);
+		return;
+	}
+	
+	fmpz_mat_t tree;
+	gen_power_tree(base, digits.size(), tree);
+	b2n_tree(digits, base, tree, countsOut, nOut);
+	fmpz_mat_clear(tree);
+}
+
+template <typename Sym>
+void b2n_tree(std::vector<Sym>& digits, int base, fmpz_mat_t tree, std::vector<int>& countsOut, fmpz_t nOut) {
+	//Converts little-endian digits to a number by recursively joining halves, 
+	//which lets the big multiplications run at FLINT's fast multiply speed instead of O(n^2)
+	int len = digits.size();
+	for (int i = 0; i < len; i++) {
+		countsOut[digits[i]]++;
+	}
+	b2n_recur(digits.data(), len, base, tree, nOut);
+}
+
+void b2n_ui(std::vector<ulong>& digits, int base, fmpz_t nOut) {
+	//Sums digits[i] * base^i where the digits are full words, (i.e. not limited to less than the base)
+	fmpz_mat_t tree;
+	gen_power_tree(base, digits.size(), tree);
+	b2n_recur(digits.data(), digits.size(), base, tree, nOut);
+	fmpz_mat_clear(tree);
+}
+
+template <typename Sym>
+void n2b_recur(fmpz_t n, Sym* digitsOut, int len, int base, fmpz_mat_t tree) {
+	if (len <= B2N_CUTOFF) { //Anchor
+		fmpz_t q;
+		fmpz_init(q);
+		fmpz_set(q, n);
+		for (int i = 0; i < len; i++) {
+			digitsOut[i] = fmpz_fdiv_ui(q, base);
+			fmpz_fdiv_q_ui(q, q, base);
+		}
+		fmpz_clear(q);
+		return;
+	}
+	
+	//Split with the same power as b2n, so the remainders line up with the digit halves
+	int level = power_tree_levels(len) - 1;
+	int half = 1 << level;
+	
+	fmpz_t hi;
+	fmpz_t lo;
+	fmpz_init(hi);
+	fmpz_init(lo);
+	fmpz_fdiv_qr(hi, lo, n, fmpz_mat_entry(tree, 0, level));
+	n2b_recur(lo, digitsOut, half, base, tree);
+	fmpz_clear(lo);
+	n2b_recur(hi, digitsOut + half, len - half, base, tree);
+	fmpz_clear(hi);
+}
+
+template <typename Sym>
+void n2b(fmpz_t n, int base, std::vector<Sym>& digitsOut) {
+	//Inverse of b2n - the number of digits is taken from the size of digitsOut
+	int bits = pow2_digit_bits(base);
+	if (bits > 0) {
+		n2b_pow2(n, bits, digitsOut);
+		return;
+	}
+	
+	fmpz_mat_t tree;
+	gen_power_tree(base, digitsOut.size(), tree);
+	n2b_tree(n, base, tree, digitsOut);
+	fmpz_mat_clear(tree);
+}
+
+template <typename Sym>
+void n2b_tree(fmpz_t n, int base, fmpz_mat_t tree, std::vector<Sym>& digitsOut) {
+	//Converts a number back to little-endian digits with a remainder tree over the cached powers
+	n2b_recur(n, digitsOut.data(), digitsOut.size(), base, tree);
+}
+
+template <typename Sym>
+void n2b_pow2(fmpz_t n, int bits, std::vector<Sym>& digitsOut) {
+	//For power-of-two bases the digits are just shifted and masked out of the limbs
+	int len = digitsOut.size();
+	int digitsPerLimb = FLINT_BITS / bits;
+	mp_limb_t mask = (UWORD(1) << bits) - 1;
+	
+	mpz_t z;
+	mpz_init(z);
+	fmpz_get_mpz(z, n);
+	const mp_limb_t* limbs = mpz_limbs_read(z);
+	int limbCount = mpz_size(z);
+	
+	for (int i = 0; i < len; i++) {
+		int l = i / digitsPerLimb;
+		if (l >= limbCount) digitsOut[i] = 0;
+		else digitsOut[i] = (limbs[l] >> (bits * (i % digitsPerLimb))) & mask;
+	}
+	mpz_clear(z);
+}
+
+
+#define BASE_INSTANTIATE(Sym) \
+	template void b2n(std::vector<Sym>& digits, int base, std::vector<int>& countsOut, fmpz_t nOut); \
+	template void b2n_tree(std::vector<Sym>& digits, int base, fmpz_mat_t tree, std::vector<int>& countsOut, fmpz_t nOut); \
+	template void b2n_pow2(std::vector<Sym>& digits, int bits, std::vector<int>& countsOut, fmpz_t nOut); \
+	template void n2b(fmpz_t n, int base, std::vector<Sym>& digitsOut); \
+	template void n2b_tree(fmpz_t n, int base, fmpz_mat_t tree, std::vector<Sym>& digitsOut); \
+	template void n2b_pow2(fmpz_t n, int bits, std::vector<Sym>& digitsOut);
+
+BASE_INSTANTIATE(uint8_t)
+BASE_INSTANTIATE(uint16_t)
+
+
+void indexed_bits_build(IndexedBits& bits) {
+	//Fenwick tree in O(words), (each node passes its count up to its parent)
+	int wordCount = bits.words.size();
+	bits.tree.assign(wordCount+1, 0);
+	for (int i = 1; i <= wordCount; i++) {
+		bits.tree[i] += __builtin_popcountll(bits.words[i-1]);
+		int parent = i + (i & -i);
+		if (parent <= wordCount) bits.tree[parent] += bits.tree[i];
+	}
+}
+
+void indexed_bits_init(int n, IndexedBits& bitsOut) {
+	bitsOut.size = n;
+	bitsOut.words.assign((n + 63) / 64, ~UINT64_C(0));
+	if (n % 64 != 0) bitsOut.words.back() = (UINT64_C(1) << (n % 64)) - 1;
+	indexed_bits_build(bitsOut);
+}
+
+int indexed_bits_rank(IndexedBits& bits, int val) {
+	int word = val / 64;
+	int rank = __builtin_popcountll(bits.words[word] & ((UINT64_C(1) << (val % 64)) - 1));
+	for (int i = word; i > 0; i -= i & -i) rank += bits.tree[i];
+	return rank;
+}
+
+int indexed_bits_select(IndexedBits& bits, int index) {
+	//Walk down the Fenwick tree to the word holding the element, and then down the word
+	int wordCount = bits.words.size();
+	int word = 0;
+	int step = 1;
+	while (step * 2 <= wordCount) step *= 2;
+	for (; step > 0; step /= 2) {
+		if (word + step <= wordCount && bits.tree[word + step] <= index) {
+			word += step;
+			index -= bits.tree[word];
+		}
+	}
+	uint64_t bitsLeft = bits.words[word];
+	for (int i = 0; i < index; i++) bitsLeft &= bitsLeft - 1;
+	return word * 64 + __builtin_ctzll(bitsLeft);
+}
+
+void indexed_bits_erase(IndexedBits& bits, int val) {
+	int word = val / 64;
+	bits.words[word] &= ~(UINT64_C(1) << (val % 64));
+	for (int i = word+1; i <= (int)bits.words.size(); i += i & -i) bits.tree[i]--;
+	bits.size--;
+}
+
+void indexed_bits_erase_all(IndexedBits& bits, std::vector<int>& vals) {
+	//A big part is cheaper to clear and then rebuild the tree for, than to update per element
+	int wordCount = bits.words.size();
+	if ((slong)vals.size() * FLINT_BIT_COUNT(wordCount) < wordCount) {
+		for (int val : vals) indexed_bits_erase(bits, val);
+		return;
+	}
+	for (int val : vals) bits.words[val / 64] &= ~(UINT64_C(1) << (val % 64));
+	bits.size -= vals.size();
+	indexed_bits_build(bits);
+}
+
+void indexed_bits_list(IndexedBits& bits, std::vector<int>& valsOut) {
+	valsOut.clear();
+	for (int w = 0; w < (int)bits.words.size(); w++) {
+		for (uint64_t bitsLeft = bits.words[w]; bitsLeft != 0; bitsLeft &= bitsLeft - 1) {
+			valsOut.push_back(w * 64 + __builtin_ctzll(bitsLeft));
+		}
 	}
 }
 
@@ -28,4 +295,14 @@ double measureEntropy(std::vector<int>& counts, int seqLen) {
 	}
 	return -total;
 	
+}
+
+void gen_xlogx(int n, std::vector<double>& xLogXOut) {
+	//Table of c*log2(c) for counts [0, n].  The entropy of a sequence is then 
+	//xLogX[n] - sum(xLogX[count]), which can be tracked as the counts change
+	xLogXOut.resize(n+1);
+	xLogXOut[0] = 0.0;
+	for (int c = 1; c <= n; c++) {
+		xLogXOut[c] = c * std::log2(c);
+	}
 }
\ No newline at end of file
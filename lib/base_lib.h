@@ -3,7 +3,44 @@
 #include <cstdint>
 #include <cmath>
 #include "flint/fmpz.h"
+#include "flint/fmpz_mat.h"
 
-void b2n(std::vector<uint8_t>& digits, int base, std::vector<int>& countsOut, fmpz_t nOut);
+const double NO_ENTROPY_BOUND = INFINITY;
+const double ENTROPY_EPS = 1e-6; //Slack so that rounding never abandons a candidate that could still win
 
-double measureEntropy(std::vector<int>& counts, int seqLen);
\ No newline at end of file
+struct IndexedBits {
+	//Ordered set of the ints [0, n), as one bit each, plus a Fenwick tree over the popcounts of the words,
+	//so that rank and select are O(log(n/64)), (about 1.5 bits per element, instead of a tree node each)
+	int size; //Elements in the set
+	std::vector<uint64_t> words;
+	std::vector<int> tree; //Fenwick tree, 1-indexed by word
+};
+
+void gen_power_tree(int base, int len, fmpz_mat_t treeOut); 
+int pow2_digit_bits(int base);
+
+//The digit functions are templated on the digit type, (instantiated for uint8_t and uint16_t in base_lib.cpp)
+template <typename Sym>
+void b2n(std::vector<Sym>& digits, int base, std::vector<int>& countsOut, fmpz_t nOut);
+template <typename Sym>
+void b2n_tree(std::vector<Sym>& digits, int base, fmpz_mat_t tree, std::vector<int>& countsOut, fmpz_t nOut); //Use Precomputed Power Tree
+template <typename Sym>
+void b2n_pow2(std::vector<Sym>& digits, int bits, std::vector<int>& countsOut, fmpz_t nOut); //Bases 2, 4, 16, 256, (and 65536)
+void b2n_ui(std::vector<ulong>& digits, int base, fmpz_t nOut);
+
+template <typename Sym>
+void n2b(fmpz_t n, int base, std::vector<Sym>& digitsOut);
+template <typename Sym>
+void n2b_tree(fmpz_t n, int base, fmpz_mat_t tree, std::vector<Sym>& digitsOut); //Use Precomputed Power Tree
+template <typename Sym>
+void n2b_pow2(fmpz_t n, int bits, std::vector<Sym>& digitsOut); //Bases 2, 4, 16, 256, (and 65536)
+
+void indexed_bits_init(int n, IndexedBits& bitsOut); //Full
+int indexed_bits_rank(IndexedBits& bits, int val); //Elements less than val
+int indexed_bits_select(IndexedBits& bits, int index); //Element at index
+void indexed_bits_erase(IndexedBits& bits, int val);
+void indexed_bits_erase_all(IndexedBits& bits, std::vector<int>& vals); //Bulk
+void indexed_bits_list(IndexedBits& bits, std::vector<int>& valsOut);
+
+double measureEntropy(std::vector<int>& counts, int seqLen);
+void gen_xlogx(int n, std::vector<double>& xLogXOut);
\ No newline at end of file
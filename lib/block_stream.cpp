@@ -0,0 +1,404 @@
+#include "block_stream.h"
+#include "io_lib.h"
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <climits>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+const int INVALID = -1;
+
+int encode_block(const uint8_t* vals, int len, const BlockStreamOptions& options, std::vector<uint8_t>& entSeqOut, double& deltaOut) {
+	std::vector<uint8_t> valSeq(vals, vals + len);
+	std::vector<int> valCounts(BLOCK_SYMS);
+	fmpz_t normRank;
+	fmpz_init(normRank);
+	b2n(valSeq, BLOCK_SYMS, valCounts, normRank);
+	double valEntropy = measureEntropy(valCounts, len);
+
+	//Same search as main - K extra symbols give the rank room to land on a lower entropy sequence
+	fmpz_t normCopy;
+	fmpz_init(normCopy);
+	int bestK = -1;
+	double bestDelta = 0;
+	std::vector<uint8_t> entSeq;
+	std::vector<int> entCounts;
+	for (int k = 0; k < std::max(options.kSearch, 1); k++) {
+		fmpz_set(normCopy, normRank);
+		entSeq.assign(len+k, 0);
+		entCounts.assign(BLOCK_SYMS, 0);
+		double maxEntropy = NO_ENTROPY_BOUND;
+		if (bestK != -1) maxEntropy = valEntropy - bestDelta; //Early abandon
+		bool completed;
+		if (options.engine == BLOCK_ENGINE_NEARER) completed = nearer_entropic_unrank(normCopy, len+k, BLOCK_SYMS, entCounts, entSeq, maxEntropy);
+		else completed = near_entropic_unrank(normCopy, len+k, BLOCK_SYMS, entCounts, entSeq, maxEntropy);
+		if (!completed) continue;
+
+		double delta = valEntropy - measureEntropy(entCounts, len+k);
+		if (bestK == -1 || delta > bestDelta) {
+			bestDelta = delta;
+			bestK = k;
+			entSeqOut.swap(entSeq);
+		}
+	}
+	fmpz_clear(normCopy);
+
+	if (options.verify) {
+		fmpz_t rank;
+		fmpz_init(rank);
+		if (options.engine == BLOCK_ENGINE_NEARER) nearer_entropic_rank(entSeqOut, BLOCK_SYMS, rank);
+		else near_entropic_rank(entSeqOut, BLOCK_SYMS, rank);
+		if (!fmpz_equal(rank, normRank)) bestK = BLOCK_VERIFY_FAILED;
+		fmpz_clear(rank);
+	}
+	fmpz_clear(normRank);
+	deltaOut = bestDelta;
+	return bestK;
+}
+
+bool decode_block(std::vector<uint8_t>& entSeq, int engine, int maxSym, std::vector<uint8_t>& valsOut) {
+	//A sequence with K extra symbols can rank past maxSym^len, and n2b would quietly drop the high digits
+	fmpz_t rank, limit;
+	fmpz_init(rank);
+	fmpz_init(limit);
+	if (engine == BLOCK_ENGINE_NEARER) nearer_entropic_rank(entSeq, maxSym, rank);
+	else near_entropic_rank(entSeq, maxSym, rank);
+	fmpz_ui_pow_ui(limit, maxSym, valsOut.size());
+	bool fits = fmpz_cmp(rank, limit) < 0;
+	if (fits) n2b(rank, maxSym, valsOut);
+	fmpz_clear(limit);
+	fmpz_clear(rank);
+	return fits;
+}
+
+uint64_t block_stream_checksum(const uint8_t* bytes, size_t length, uint64_t hash) {
+	//As table_store_checksum, for bytes that needn't be aligned, (the last word is padded with zeros)
+	for (size_t i = 0; i < length; i += sizeof(uint64_t)) {
+		uint64_t word = 0;
+		std::copy(bytes + i, bytes + std::min(i + sizeof(uint64_t), length), (uint8_t*)&word);
+		hash = table_store_checksum(&word, 1, hash);
+	}
+	return hash;
+}
+
+bool block_stream_map(const char* filename, void*& mapOut, size_t& lengthOut) {
+	//Read-only, and read front to back, (an empty file has nothing to map)
+	mapOut = NULL;
+	lengthOut = 0;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		perror("Could not open file for reading");
+		return false;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		perror("Could not open file for reading");
+		return false;
+	}
+	lengthOut = info.st_size;
+	if (lengthOut > 0) {
+		mapOut = mmap(NULL, lengthOut, PROT_READ, MAP_SHARED, fd, 0);
+		if (mapOut == MAP_FAILED) {
+			close(fd);
+			mapOut = NULL;
+			perror("Could not map file");
+			return false;
+		}
+		madvise(mapOut, lengthOut, MADV_SEQUENTIAL);
+	}
+	close(fd); //The mapping keeps the file open
+	return true;
+}
+
+void block_stream_unmap(void* map, size_t length) {
+	if (map) munmap(map, length);
+}
+
+bool block_stream_finish(FILE* file, const std::string& tempName, const char* filename) {
+	//Output goes to a unique temporary file that's renamed once it's complete, (as in table_store_write)
+	bool written = !ferror(file);
+	fclose(file);
+	if (!written || rename(tempName.c_str(), filename) != 0) {
+		perror("Could not write file");
+		remove(tempName.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool block_stream_append(FILE* from, FILE* to) {
+	//Copies the whole of from onto the end of to, a buffer at a time
+	std::vector<uint8_t> buffer(1 << 16);
+	rewind(from);
+	size_t got;
+	while ((got = fread(buffer.data(), 1, buffer.size(), from)) > 0) {
+		fwrite(buffer.data(), 1, got, to);
+	}
+	return !ferror(from) && !ferror(to);
+}
+
+ThreadPool& block_stream_pool(const BlockStreamOptions& options, std::unique_ptr<ThreadPool>& ownPoolOut) {
+	//The caller works on the blocks too, so that's one less worker than threads asked for
+	if (options.threads <= 0) return get_thread_pool();
+	ownPoolOut.reset(new ThreadPool(options.threads - 1));
+	return *ownPoolOut;
+}
+
+int block_stream_window(const BlockStreamOptions& options, ThreadPool& pool) {
+	if (options.window > 0) return options.window;
+	return 4 * (pool.threads.size() + 1);
+}
+
+bool block_stream_encode(const char* inFilename, const char* outFilename, const BlockStreamOptions& options, BlockStreamStats& statsOut) {
+	statsOut = BlockStreamStats();
+	if (options.blockSize < 1) {
+		fprintf(stderr, "Invalid block size: %d\n", options.blockSize);
+		return false;
+	}
+	if (options.kSearch > BLOCK_MAX_K_SEARCH) {
+		fprintf(stderr, "Invalid K search: %d\n", options.kSearch);
+		return false;
+	}
+	void* map;
+	size_t inputSize;
+	if (!block_stream_map(inFilename, map, inputSize)) return false;
+	const uint8_t* input = (const uint8_t*)map;
+	uint64_t blockCount = (inputSize + options.blockSize - 1) / options.blockSize;
+	if (blockCount > INT_MAX) {
+		fprintf(stderr, "Too many blocks, (try a bigger block size): %llu\n", (unsigned long long)blockCount);
+		block_stream_unmap(map, inputSize);
+		return false;
+	}
+
+	std::string tempName;
+	FILE* file = open_temp_file(outFilename, tempName);
+	FILE* indexFile = file? tmpfile() : NULL; //The index entries wait here until the blocks are all written
+	if (!indexFile) {
+		perror("Could not open file for writing");
+		if (file) {
+			fclose(file);
+			remove(tempName.c_str());
+		}
+		block_stream_unmap(map, inputSize);
+		return false;
+	}
+	BlockStreamHeader header = {};
+	std::copy(BLOCK_STREAM_MAGIC, BLOCK_STREAM_MAGIC + 8, header.magic);
+	header.version = BLOCK_STREAM_VERSION;
+	header.blockSize = options.blockSize;
+	fwrite(&header, sizeof(header), 1, file);
+	statsOut.outputSize = sizeof(header);
+
+	//Reorder buffer - block i is encoded into slot i % window, and written once all the blocks before it are
+	std::unique_ptr<ThreadPool> ownPool;
+	ThreadPool& pool = block_stream_pool(options, ownPool);
+	int window = block_stream_window(options, pool);
+	std::vector<std::vector<uint8_t>> slots(window);
+	std::vector<int> ks(window);
+	std::vector<double> deltas(window);
+	uint64_t checksum = 0;
+	int failedBlock = INVALID;
+	auto blockLen = [&](int i) { return (int)std::min<uint64_t>(options.blockSize, inputSize - (uint64_t)i * options.blockSize); };
+	thread_pool_run_ordered(pool, blockCount, window,
+		[&](int i) {
+			ks[i % window] = encode_block(input + (uint64_t)i * options.blockSize, blockLen(i), options, slots[i % window], deltas[i % window]);
+		},
+		[&](int i) {
+			if (ks[i % window] == BLOCK_VERIFY_FAILED && failedBlock == INVALID) failedBlock = i;
+			if (failedBlock != INVALID) return; //(Nothing more is written, the file is thrown away)
+			std::vector<uint8_t>& entSeq = slots[i % window];
+			StreamBlockHeader blockHeader = {(uint8_t)options.engine, (uint8_t)ks[i % window], (uint16_t)BLOCK_SYMS, (uint32_t)blockLen(i)};
+			uint64_t blockChecksum = block_stream_checksum((const uint8_t*)&blockHeader, sizeof(blockHeader), 0);
+			blockChecksum = block_stream_checksum(entSeq.data(), entSeq.size(), blockChecksum);
+			BlockIndexEntry entry = {statsOut.outputSize, (uint64_t)i * options.blockSize, blockChecksum};
+			fwrite(&entry, sizeof(entry), 1, indexFile);
+			checksum = table_store_checksum((const uint64_t*)&entry, sizeof(entry) / sizeof(uint64_t), checksum);
+			fwrite(&blockHeader, sizeof(blockHeader), 1, file);
+			fwrite(entSeq.data(), 1, entSeq.size(), file);
+			statsOut.outputSize += sizeof(blockHeader) + entSeq.size();
+			statsOut.deltaSum += deltas[i % window];
+		}
+	);
+	block_stream_unmap(map, inputSize);
+	if (failedBlock != INVALID) {
+		fprintf(stderr, "Block rank does not match: %d\n", failedBlock);
+		fclose(indexFile);
+		fclose(file);
+		remove(tempName.c_str());
+		return false;
+	}
+
+	//The index is padded out to whole words, so it can be read in place
+	while (statsOut.outputSize % sizeof(uint64_t) != 0) {
+		fputc(0, file);
+		statsOut.outputSize++;
+	}
+	BlockStreamFooter footer = {};
+	footer.indexOffset = statsOut.outputSize;
+	footer.blockCount = blockCount;
+	footer.inputSize = inputSize;
+	footer.checksum = checksum;
+	std::copy(BLOCK_INDEX_MAGIC, BLOCK_INDEX_MAGIC + 8, footer.magic);
+	bool spilled = block_stream_append(indexFile, file);
+	fclose(indexFile); //(Deleted as it's closed)
+	if (!spilled) {
+		fclose(file);
+		remove(tempName.c_str());
+		perror("Could not write file");
+		return false;
+	}
+	fwrite(&footer, sizeof(footer), 1, file);
+	statsOut.outputSize += blockCount * sizeof(BlockIndexEntry) + sizeof(footer);
+	statsOut.blockCount = blockCount;
+	statsOut.inputSize = inputSize;
+	return block_stream_finish(file, tempName, outFilename);
+}
+
+bool block_stream_open(const char* filename, BlockStreamReader& readerOut) {
+	//Maps a stream and checks the index, (the blocks themselves are only checked against it as they're decoded)
+	readerOut = BlockStreamReader();
+	void* map;
+	size_t length;
+	if (!block_stream_map(filename, map, length)) return false;
+	readerOut.map = map;
+	readerOut.length = length;
+
+	const uint8_t* bytes = (const uint8_t*)map;
+	const BlockStreamHeader* header = (const BlockStreamHeader*)map;
+	bool valid = length >= sizeof(BlockStreamHeader) + sizeof(BlockStreamFooter) && length % sizeof(uint64_t) == 0; //(So the footer can be read in place)
+	const BlockStreamFooter* footer = valid? (const BlockStreamFooter*)(bytes + length - sizeof(BlockStreamFooter)) : NULL;
+	valid = valid
+		&& std::equal(BLOCK_STREAM_MAGIC, BLOCK_STREAM_MAGIC + 8, header->magic)
+		&& header->version == BLOCK_STREAM_VERSION
+		&& std::equal(BLOCK_INDEX_MAGIC, BLOCK_INDEX_MAGIC + 8, footer->magic)
+		&& footer->blockCount <= INT_MAX
+		&& footer->indexOffset >= sizeof(BlockStreamHeader)
+		&& footer->indexOffset % sizeof(uint64_t) == 0
+		&& footer->indexOffset + footer->blockCount * sizeof(BlockIndexEntry) + sizeof(BlockStreamFooter) == length;
+	const BlockIndexEntry* index = valid? (const BlockIndexEntry*)(bytes + footer->indexOffset) : NULL;
+	if (valid) valid = table_store_checksum((const uint64_t*)index, footer->blockCount * sizeof(BlockIndexEntry) / sizeof(uint64_t), 0) == footer->checksum;
+
+	//Blocks in order, with room for their headers, and covering the output from 0
+	for (uint64_t i = 0; valid && i < footer->blockCount; i++) {
+		uint64_t recordEnd = (i+1 < footer->blockCount)? index[i+1].offset : footer->indexOffset;
+		uint64_t end = (i+1 < footer->blockCount)? index[i+1].start : footer->inputSize;
+		valid = index[i].offset >= sizeof(BlockStreamHeader) && index[i].offset + sizeof(StreamBlockHeader) <= recordEnd
+			&& index[i].start <= end && (i > 0 || index[i].start == 0);
+	}
+	if (valid && footer->blockCount == 0) valid = footer->inputSize == 0;
+	if (!valid) {
+		fprintf(stderr, "Invalid stream file: %s\n", filename);
+		block_stream_close(readerOut);
+		return false;
+	}
+	readerOut.header = header;
+	readerOut.footer = footer;
+	readerOut.index = index;
+	return true;
+}
+
+void block_stream_close(BlockStreamReader& reader) {
+	block_stream_unmap(reader.map, reader.length);
+	reader = BlockStreamReader();
+}
+
+bool block_stream_decode_block(BlockStreamReader& reader, int i, std::vector<uint8_t>& valsOut) {
+	//Decodes block i, as long as its header and payload match the checksum in the index.  maxSym still has to be the one
+	//the encoder writes - a smaller one would let payload bytes past the end of the symbol tables
+	const uint8_t* bytes = (const uint8_t*)reader.map;
+	uint64_t blockCount = reader.footer->blockCount;
+	uint64_t recordEnd = (i+1 < (int)blockCount)? reader.index[i+1].offset : reader.footer->indexOffset;
+	uint64_t end = (i+1 < (int)blockCount)? reader.index[i+1].start : reader.footer->inputSize;
+	StreamBlockHeader blockHeader;
+	std::copy(bytes + reader.index[i].offset, bytes + reader.index[i].offset + sizeof(blockHeader), (uint8_t*)&blockHeader);
+	uint64_t payload = reader.index[i].offset + sizeof(blockHeader);
+	bool valid = (blockHeader.engine == BLOCK_ENGINE_NEAR || blockHeader.engine == BLOCK_ENGINE_NEARER)
+		&& blockHeader.maxSym == BLOCK_SYMS
+		&& blockHeader.seqLen == end - reader.index[i].start
+		&& (uint64_t)blockHeader.seqLen + blockHeader.k <= recordEnd - payload; //(The last one can be followed by padding)
+	if (!valid) return false;
+	std::vector<uint8_t> entSeq(bytes + payload, bytes + payload + blockHeader.seqLen + blockHeader.k);
+	uint64_t blockChecksum = block_stream_checksum((const uint8_t*)&blockHeader, sizeof(blockHeader), 0);
+	if (block_stream_checksum(entSeq.data(), entSeq.size(), blockChecksum) != reader.index[i].checksum) return false;
+
+	valsOut.resize(blockHeader.seqLen);
+	return decode_block(entSeq, blockHeader.engine, blockHeader.maxSym, valsOut);
+}
+
+bool block_stream_read(BlockStreamReader& reader, uint64_t start, uint64_t length, const BlockStreamOptions& options, uint8_t* bytesOut) {
+	//Only the blocks overlapping the range are touched, and they're decoded side by side
+	uint64_t inputSize = reader.footer->inputSize;
+	if (start > inputSize || length > inputSize - start) return false;
+	if (length == 0) return true;
+	const BlockIndexEntry* begin = reader.index;
+	const BlockIndexEntry* end = reader.index + reader.footer->blockCount;
+	auto blockOf = [&](uint64_t pos) {
+		return (int)(std::upper_bound(begin, end, pos, [](uint64_t val, const BlockIndexEntry& entry) { return val < entry.start; }) - begin) - 1;
+	};
+	int first = blockOf(start);
+	int last = blockOf(start + length - 1);
+
+	std::unique_ptr<ThreadPool> ownPool;
+	ThreadPool& pool = block_stream_pool(options, ownPool);
+	std::atomic<bool> valid{true};
+	thread_pool_run(pool, last - first + 1, [&](int j) {
+		int i = first + j;
+		std::vector<uint8_t> vals;
+		if (!block_stream_decode_block(reader, i, vals)) {
+			valid = false;
+			return;
+		}
+		uint64_t blockStart = reader.index[i].start;
+		uint64_t from = std::max(start, blockStart);
+		uint64_t to = std::min(start + length, blockStart + vals.size());
+		std::copy(vals.begin() + (from - blockStart), vals.begin() + (to - blockStart), bytesOut + (from - start));
+	});
+	return valid;
+}
+
+bool block_stream_decode(const char* inFilename, const char* outFilename, const BlockStreamOptions& options, BlockStreamStats& statsOut) {
+	statsOut = BlockStreamStats();
+	BlockStreamReader reader;
+	if (!block_stream_open(inFilename, reader)) return false;
+	std::string tempName;
+	FILE* file = open_temp_file(outFilename, tempName);
+	if (!file) {
+		perror("Could not open file for writing");
+		block_stream_close(reader);
+		return false;
+	}
+
+	//Whole file, in order, through the same reorder buffer as encoding
+	int blockCount = reader.footer->blockCount;
+	std::unique_ptr<ThreadPool> ownPool;
+	ThreadPool& pool = block_stream_pool(options, ownPool);
+	int window = block_stream_window(options, pool);
+	std::vector<std::vector<uint8_t>> slots(window);
+	std::vector<char> decoded(window);
+	bool valid = true;
+	thread_pool_run_ordered(pool, blockCount, window,
+		[&](int i) {
+			decoded[i % window] = block_stream_decode_block(reader, i, slots[i % window]);
+		},
+		[&](int i) {
+			valid = valid && decoded[i % window];
+			if (valid) fwrite(slots[i % window].data(), 1, slots[i % window].size(), file);
+		}
+	);
+	statsOut.blockCount = blockCount;
+	statsOut.inputSize = reader.length;
+	statsOut.outputSize = reader.footer->inputSize;
+	block_stream_close(reader);
+	if (!valid) {
+		fclose(file);
+		remove(tempName.c_str());
+		fprintf(stderr, "Invalid stream file: %s\n", inFilename);
+		return false;
+	}
+	return block_stream_finish(file, tempName, outFilename);
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+#include <iostream>
+#include <cstdint>
+#include <vector>
+
+#include "flint/fmpz.h"
+#include "base_lib.h"
+#include "near_entropic.h"
+#include "nearer_entropic.h"
+#include "thread_pool.h"
+
+//Streaming file transform.  The input is mapped and cut into blocks of bytes, and each block is swapped for the
+//lowest entropy sequence of the K search, (b2n -> entropic unrank -> best K, as in main), on the thread pool.
+//The blocks go out in order through a bounded reorder buffer, so memory stays flat however big the file is, (the index is spilled to a temporary file).
+//The file ends with an index of the blocks, so any range can be decoded from just the blocks that overlap it
+const char BLOCK_STREAM_MAGIC[8] = {'D', 'E', 'C', 'I', 'M', 'S', 'T', 'R'};
+const char BLOCK_INDEX_MAGIC[8] = {'D', 'E', 'C', 'I', 'M', 'I', 'D', 'X'};
+const uint32_t BLOCK_STREAM_VERSION = 4;
+const int BLOCK_SYMS = 256; //Raw bytes
+const int BLOCK_MAX_K_SEARCH = 256; //So K fits in the block header
+
+const int BLOCK_ENGINE_NEAR = 0;
+const int BLOCK_ENGINE_NEARER = 1;
+const int BLOCK_VERIFY_FAILED = -1; //From encode_block, if the chosen sequence doesn't rank back to the block
+
+struct BlockStreamOptions {
+	int blockSize = 64; //Bytes, (the unrank cost grows much faster than the length)
+	int kSearch = 5;
+	int engine = BLOCK_ENGINE_NEAR;
+	int threads = 0; //0 for one per core
+	int window = 0; //Blocks held for in-order writing, (0 for 4 per thread)
+	bool verify = false; //Rank each chosen sequence again and check it matches
+};
+
+struct BlockStreamHeader { //Followed by the blocks, then the index
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t blockSize; //Of every block but the last, (as encoded - the index is what readers go by)
+};
+
+struct StreamBlockHeader { //Followed by seqLen + k symbols of the sequence, (one byte each)
+	uint8_t engine;
+	uint8_t k; //The best K
+	uint16_t maxSym;
+	uint32_t seqLen; //Of the input block
+};
+
+struct BlockIndexEntry {
+	uint64_t offset; //Of the block header in the file
+	uint64_t start; //Of the block in the decoded output, (it runs to the next start)
+	uint64_t checksum; //Of the block header and payload, (so it's covered by the index checksum too)
+};
+
+struct BlockStreamFooter { //The last bytes of the file, straight after blockCount index entries
+	uint64_t indexOffset;
+	uint64_t blockCount;
+	uint64_t inputSize;
+	uint64_t checksum; //Of the index entries
+	char magic[8];
+};
+
+struct BlockStreamReader {
+	//Read-only view of a stream file mapped into memory, (as TableStore)
+	void* map = NULL;
+	size_t length = 0;
+	const BlockStreamHeader* header = NULL;
+	const BlockStreamFooter* footer = NULL;
+	const BlockIndexEntry* index = NULL;
+};
+
+struct BlockStreamStats {
+	uint64_t blockCount = 0;
+	uint64_t inputSize = 0;
+	uint64_t outputSize = 0;
+	double deltaSum = 0; //Entropy drop summed over the blocks, (in bits, as measureEntropy)
+};
+
+int encode_block(const uint8_t* vals, int len, const BlockStreamOptions& options, std::vector<uint8_t>& entSeqOut, double& deltaOut); //Returns the best K, (or BLOCK_VERIFY_FAILED)
+bool decode_block(std::vector<uint8_t>& entSeq, int engine, int maxSym, std::vector<uint8_t>& valsOut); //The block length is taken from the size of valsOut, (false if the rank doesn't fit it)
+
+bool block_stream_encode(const char* inFilename, const char* outFilename, const BlockStreamOptions& options, BlockStreamStats& statsOut);
+bool block_stream_decode(const char* inFilename, const char* outFilename, const BlockStreamOptions& options, BlockStreamStats& statsOut);
+
+bool block_stream_open(const char* filename, BlockStreamReader& readerOut);
+void block_stream_close(BlockStreamReader& reader);
+bool block_stream_read(BlockStreamReader& reader, uint64_t start, uint64_t length, const BlockStreamOptions& options, uint8_t* bytesOut); //Decodes [start, start+length)
\ No newline at end of file
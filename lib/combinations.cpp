@@ -1,5 +1,7 @@
 #include "combinations.h"
 
+const int COMB_WALK_STEPS = 8; //Binomial steps to take before it's cheaper to recompute, (or gallop)
+
 
 uint64_t comb(int n, int k) { //Binomial co-efficient of n-choose-k
 	//IMPORTANT NOTE: This only handles values in the range of uint64_t	
@@ -7,17 +9,20 @@ uint64_t comb(int n, int k) { //Binomial co-efficient of n-choose-k
 	uint64_t res = 1;
 
 	if ((k < 0) || (n < k)) return 0;
+	if (n <= SMALL_SYM_MAX) return PASCAL.c[n][k];
 	if ((2*k) > n) k = n-k;
 	
 	if (k > 0) {
 		for(int i = 0; i <= (k-1); i++) {
-			res = (res * (n-i))/(i+1);
+			//C(n,i) * (n-i) can overflow even when C(n,i+1) fits, so it's done in 128 bits
+			res = (uint64_t)(((unsigned __int128)res * (n-i))/(i+1));
 		}
 	}
 	return res;
 }
 
-uint64_t comb_rank(std::vector<uint8_t>& vals) {
+template <typename Sym>
+uint64_t comb_rank(std::vector<Sym>& vals) {
 	int k = vals.size();
 	uint64_t rankOut = 0;
 	
@@ -27,15 +32,36 @@ uint64_t comb_rank(std::vector<uint8_t>& vals) {
 	return rankOut;
 }
 
-void comb_rank(std::vector<int>& vals, fmpz_t rankOut) {
+template <typename Sym>
+void comb_rank(std::vector<Sym>& vals, fmpz_t rankOut) {
+	//Steps between neighbouring binomials instead of recomputing each one:  C(v,t) -> C(v+1,t) = C(v,t)*(v+1)/(v+1-t) 
+	//walks up to the next val, and C(v,t) -> C(v,t+1) = C(v,t)*(v-t)/(t+1) moves to the next digit.
+	//(Big jumps between vals are cheaper to recompute from scratch)
 	int k = vals.size();	
 	fmpz_init(rankOut);
 	fmpz_zero(rankOut);
 		
 	fmpz_t cmb;
 	fmpz_init(cmb);	
+	int v = 0; 
+	bool stepped = false; //Whether cmb is a non-zero C(v, i), that can be stepped from
 	for (int i = 0; i < k; i++) {
-		fmpz_bin_uiui(cmb, vals[k-1-i], k-i);
+		int val = vals[i];
+		if (val < i+1) { //C(val, i+1) = 0
+			stepped = false;
+			continue;
+		}
+		if (!stepped || val - v > COMB_WALK_STEPS) fmpz_bin_uiui(cmb, val, i+1);
+		else {
+			for (; v < val; v++) {
+				fmpz_mul_ui(cmb, cmb, v+1);
+				fmpz_divexact_ui(cmb, cmb, v+1-i);
+			}
+			fmpz_mul_ui(cmb, cmb, val-i);
+			fmpz_divexact_ui(cmb, cmb, i+1);
+		}
+		v = val;
+		stepped = true;
 		fmpz_add(rankOut, rankOut, cmb);		
 	}
 	fmpz_clear(cmb);
@@ -43,7 +69,8 @@ void comb_rank(std::vector<int>& vals, fmpz_t rankOut) {
 }
 
 
-void comb_unrank(uint64_t rank, int n, int k, std::vector<uint8_t>& valsOut) {	
+template <typename Sym>
+void comb_unrank(uint64_t rank, int n, int k, std::vector<Sym>& valsOut) {	
 	
 	for (int i = 0; i < k; i++) {
 		while (comb(n, k-i) > rank) {			
@@ -55,20 +82,66 @@ void comb_unrank(uint64_t rank, int n, int k, std::vector<uint8_t>& valsOut) {
 }
 
 
-void comb_unrank(fmpz_t rank, int n, int k, std::vector<int>& valsOut) {
+int comb_gallop(fmpz_t rank, int n, int k, fmpz_t cmbOut) {
+	//Largest v < n with C(v, k) <= rank, (given C(n, k) > rank).  Gallops down in doubling steps,
+	//and then bisects, so a long way down only costs a log number of binomials
+	int lo = k-1; //C(k-1, k) = 0
+	int hi = n;
+	for (int step = 1; hi - step > lo; step *= 2) {
+		fmpz_bin_uiui(cmbOut, hi - step, k);
+		if (fmpz_cmp(cmbOut, rank) <= 0) {
+			lo = hi - step;
+			break;
+		}
+		hi -= step;
+	}
+	while (hi - lo > 1) {
+		int mid = lo + (hi - lo) / 2;
+		fmpz_bin_uiui(cmbOut, mid, k);
+		if (fmpz_cmp(cmbOut, rank) <= 0) lo = mid;
+		else hi = mid;
+	}
+	fmpz_bin_uiui(cmbOut, lo, k);
+	return lo;
+}
+
+template <typename Sym>
+void comb_unrank(fmpz_t rank, int n, int k, std::vector<Sym>& valsOut) {
+	//Walks down from C(n, k) with C(v-1,t) = C(v,t)*(v-t)/v, and moves to the next digit with 
+	//C(v-1,t-1) = C(v,t)*t/v, (one small multiply and divide per step).  Long walks gallop instead
 	fmpz_t cmb;
 	fmpz_init(cmb);	
-	for (int i = 0; i < k; i++) {
-		fmpz_bin_uiui(cmb, n, k-i);
-		int compareCmbAndRank = fmpz_cmp(cmb, rank);
-		while (compareCmbAndRank > 0) {			
+	fmpz_bin_uiui(cmb, n, k);
+	for (int t = k; t > 0; t--) {
+		int steps = 0;
+		while (fmpz_cmp(cmb, rank) > 0) {
+			if (steps == COMB_WALK_STEPS) {
+				n = comb_gallop(rank, n, t, cmb);
+				break;
+			}
+			fmpz_mul_ui(cmb, cmb, n-t);
+			fmpz_divexact_ui(cmb, cmb, n);
 			n--;
-			fmpz_bin_uiui(cmb, n, k-i);
-			compareCmbAndRank = fmpz_cmp(cmb, rank);
+			steps++;
 		}
-		valsOut[k-i-1] = n;
-		fmpz_bin_uiui(cmb, n, k-i);
+		valsOut[t-1] = n;
 		fmpz_sub(rank, rank, cmb);		
+		if (t > 1) {
+			if (n > 0) {
+				fmpz_mul_ui(cmb, cmb, t);
+				fmpz_divexact_ui(cmb, cmb, n);
+			}
+			n--;
+		}
 	}	
 	fmpz_clear(cmb);
-}
\ No newline at end of file
+}
+
+#define COMB_INSTANTIATE(Sym) \
+	template uint64_t comb_rank(std::vector<Sym>& vals); \
+	template void comb_rank(std::vector<Sym>& vals, fmpz_t rankOut); \
+	template void comb_unrank(uint64_t rank, int n, int k, std::vector<Sym>& valsOut); \
+	template void comb_unrank(fmpz_t rank, int n, int k, std::vector<Sym>& valsOut);
+COMB_INSTANTIATE(uint8_t)
+COMB_INSTANTIATE(uint16_t)
+COMB_INSTANTIATE(int)
\ No newline at end of file
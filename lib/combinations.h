@@ -4,11 +4,35 @@
 #include "flint/fmpz.h"
 #include "flint/arith.h"
 
+const int SMALL_SYM_MAX = 20; //20! and every C(20, k) fit in 64 bits
+const int COMB_NATIVE_MAX = 67; //Every C(67, k) fits in 64 bits, (C(68, 34) does not)
+
+struct PascalTable {
+	uint64_t c[SMALL_SYM_MAX+1][SMALL_SYM_MAX+1]; //c[n][k] = n-choose-k, (0 when k > n)
+};
+
+constexpr PascalTable gen_pascal_table() {
+	PascalTable table = {};
+	for (int n = 0; n <= SMALL_SYM_MAX; n++) {
+		table.c[n][0] = 1;
+		for (int k = 1; k <= n; k++) table.c[n][k] = table.c[n-1][k-1] + (k < n? table.c[n-1][k] : 0);
+	}
+	return table;
+}
+constexpr PascalTable PASCAL = gen_pascal_table();
+
 uint64_t comb(int n, int k); //Binomial co-efficient of n-choose-k	
 
-uint64_t comb_rank(std::vector<uint8_t>& vals);
-void comb_rank(std::vector<int>& vals, fmpz_t rankOut);
+//The rank functions are templated on the value type, (instantiated for uint8_t, uint16_t, and int in combinations.cpp)
+
+template <typename Sym>
+uint64_t comb_rank(std::vector<Sym>& vals);
+template <typename Sym>
+void comb_rank(std::vector<Sym>& vals, fmpz_t rankOut);
 
-void comb_unrank(uint64_t rank, int n, int k, std::vector<uint8_t>& valsOut);
-void comb_unrank(fmpz_t rank, int n, int k, std::vector<int>& valsOut);
+template <typename Sym>
+void comb_unrank(uint64_t rank, int n, int k, std::vector<Sym>& valsOut);
+template <typename Sym>
+void comb_unrank(fmpz_t rank, int n, int k, std::vector<Sym>& valsOut);
+int comb_gallop(fmpz_t rank, int n, int k, fmpz_t cmbOut);
 	
\ No newline at end of file
@@ -1,4 +1,10 @@
 #include "io_lib.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 void printVector(std::vector<uint8_t>& vals) {    
 for (int val : vals) {
@@ -7,6 +13,13 @@ for (int val : vals) {
 	std::cout << std::endl;
 }
 
+void printVector(std::vector<uint16_t>& vals) {    
+for (int val : vals) {
+		std::cout << +val << ","; 
+	}
+	std::cout << std::endl;
+}
+
 void printVector(std::vector<int>& vals) {    
 for (int val : vals) {
 		std::cout << +val << ","; 
@@ -15,52 +28,228 @@ for (int val : vals) {
 }
 
 
-void serialize_mat(const char* filename, fmpz_mat_t mat) {
-	FILE* file = fopen(filename, "w");
-    if (!file) {
-        perror("Could not open file for writing");
-        return;
-    }
+FILE* open_temp_file(const char* filename, std::string& tempNameOut) {
+	//A unique name next to filename, so the rename is atomic, and processes writing the same file never share one
+	tempNameOut = std::string(filename) + ".XXXXXX";
+	int fd = mkstemp(&tempNameOut[0]);
+	if (fd < 0) return NULL;
+	fchmod(fd, 0644); //(mkstemp makes it private)
+	FILE* file = fdopen(fd, "wb");
+	if (!file) {
+		close(fd);
+		remove(tempNameOut.c_str());
+	}
+	return file;
+}
+
+std::string table_store_path(const char* dir, int n, int k, int engine) {
+	//Where a table is kept for its key
+	return std::string(dir) + "/table_e" + std::to_string(engine) + "_n" + std::to_string(n) + "_k" + std::to_string(k) + ".dtbl";
+}
+
+uint64_t table_store_checksum(const uint64_t* words, size_t count, uint64_t hash) {
+	//Word at a time, so checking a table runs at memory speed.  Pass the previous hash to continue it
+	for (size_t i = 0; i < count; i++) {
+		hash ^= words[i];
+		hash = (hash << 31) | (hash >> 33);
+		hash *= 0x9E3779B97F4A7C15ULL;
+	}
+	return hash;
+}
+
+bool table_store_write(const char* filename, fmpz_mat_t mat, int n, int k, int engine) {
+	//Writes to a temporary file first and renames it, so a reader never maps a partly written table
+	long count = mat->r * mat->c;
+	std::vector<int64_t> sizes(count);
+	std::vector<uint64_t> offsets(count);
+	uint64_t limbCount = 0;
+	for (long i = 0; i < count; i++) {
+		fmpz* entry = fmpz_mat_entry(mat, i / mat->c, i % mat->c);
+		sizes[i] = fmpz_size(entry) * fmpz_sgn(entry);
+		offsets[i] = limbCount;
+		limbCount += fmpz_size(entry);
+	}
 	
-	long rows = mat->r;
-	long cols = mat->c;	
+	std::string tempName;
+	FILE* file = open_temp_file(filename, tempName);
+	if (!file) {
+		perror("Could not open file for writing");
+		return false;
+	}
 	
-	//Write dimensions
-	fwrite(&rows, sizeof(long), 1, file);
-	fwrite(&cols, sizeof(long), 1, file);
+	TableStoreHeader header = {};
+	std::copy(TABLE_STORE_MAGIC, TABLE_STORE_MAGIC + 8, header.magic);
+	header.version = TABLE_STORE_VERSION;
+	header.engine = engine;
+	header.n = n;
+	header.k = k;
+	header.rows = mat->r;
+	header.cols = mat->c;
+	header.limbCount = limbCount;
 	
-	//Write each element in raw binary format
-	for (int i = 0; i < rows; i++) {
-		for (int j = 0; j < cols; j++) {			
-			fmpz_out_raw(file, fmpz_mat_entry( mat, i, j));			
-		}
+	//Header is rewritten once the checksum is known
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(sizes.data(), sizeof(int64_t), count, file);
+	fwrite(offsets.data(), sizeof(uint64_t), count, file);
+	uint64_t hash = table_store_checksum((const uint64_t*)sizes.data(), count, 0);
+	hash = table_store_checksum(offsets.data(), count, hash);
+	
+	mpz_t entry;
+	mpz_init(entry);
+	for (long i = 0; i < count; i++) {
+		fmpz_get_mpz(entry, fmpz_mat_entry(mat, i / mat->c, i % mat->c));
+		fwrite(mpz_limbs_read(entry), sizeof(mp_limb_t), mpz_size(entry), file);
+		hash = table_store_checksum((const uint64_t*)mpz_limbs_read(entry), mpz_size(entry), hash);
+	}
+	mpz_clear(entry);
+	
+	header.checksum = hash;
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, file);
+	bool written = !ferror(file);
+	written = fclose(file) == 0 && written;
+	
+	//Checked once here, before it goes in place, so readers can map it lazily
+	TableStore writtenStore;
+	if (written) written = table_store_open(tempName.c_str(), writtenStore, true);
+	table_store_close(writtenStore);
+	if (!written || rename(tempName.c_str(), filename) != 0) {
+		perror("Could not write table");
+		remove(tempName.c_str());
+		return false;
 	}
-	fclose(file);	
+	return true;
 }
 
-void deserialize_mat(const char* filename, fmpz_mat_t mat) {
-	FILE* file = fopen(filename, "r");
-    if (!file) {
-        perror("Could not open file for reading");
-        return;
-    }
+bool table_store_open(const char* filename, TableStore& storeOut, bool verify) {
+	//Maps a table read-only.  By default only the header and the bounds of the entries are checked, and the limbs are 
+	//paged in lazily, (for table_store_entry views).  Verifying the checksum touches every page, (at disk speed), 
+	//so it's for anything that copies the whole table out anyway, (load_rgf_stored, deserialize_mat)
+	storeOut = TableStore();
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) return false; //Not stored yet
 	
-	long rows = mat->r;
-	long cols = mat->c;	
-
-	//Read dimensions
-	fread(&rows, sizeof(long), 1, file);
-	fread(&cols, sizeof(long), 1, file);
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TableStoreHeader)) {
+		close(fd);
+		fprintf(stderr, "Invalid table file: %s\n", filename);
+		return false;
+	}
+	void* map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); //The mapping keeps the file open
+	if (map == MAP_FAILED) {
+		perror("Could not map table");
+		return false;
+	}
+	storeOut.map = map;
+	storeOut.length = info.st_size;
 	
-	//Init matrix
-	fmpz_mat_init(mat, rows, cols);
+	const TableStoreHeader* header = (const TableStoreHeader*)map;
+	int64_t maxWords = storeOut.length / sizeof(uint64_t);
+	bool valid = std::equal(TABLE_STORE_MAGIC, TABLE_STORE_MAGIC + 8, header->magic) 
+		&& header->version == TABLE_STORE_VERSION
+		&& header->rows >= 0 && header->cols >= 0 && header->rows <= maxWords && header->cols <= maxWords
+		&& header->limbCount <= (uint64_t)maxWords;
+	long count = valid? header->rows * header->cols : 0;
+	valid = valid && count <= maxWords / 2
+		&& storeOut.length == sizeof(TableStoreHeader) + (2 * count + header->limbCount) * sizeof(uint64_t);
 	
-	for (int i = 0; i < rows; i++) {
-		for (int j = 0; j < cols; j++) {		
-			fmpz_inp_raw(fmpz_mat_entry( mat, i, j), file);			
-		}
+	//Every entry has to lie inside the limbs, so table_store_entry never reads past the mapping, (even unverified)
+	const int64_t* sizes = (const int64_t*)(header + 1);
+	const uint64_t* offsets = (const uint64_t*)(sizes + count);
+	for (long i = 0; valid && i < count; i++) {
+		uint64_t size = (sizes[i] < 0)? -(uint64_t)sizes[i] : sizes[i];
+		valid = offsets[i] <= header->limbCount && size <= header->limbCount - offsets[i];
+	}
+	if (valid && verify) {
+		const uint64_t* words = (const uint64_t*)(header + 1);
+		valid = table_store_checksum(words, 2 * count + header->limbCount, 0) == header->checksum;
+	}
+	if (!valid) {
+		fprintf(stderr, "Invalid table file: %s\n", filename);
+		table_store_close(storeOut);
+		return false;
 	}
 	
-	fclose(file);
+	storeOut.header = header;
+	storeOut.sizes = sizes;
+	storeOut.offsets = offsets;
+	storeOut.limbs = (const mp_limb_t*)(storeOut.offsets + count);
+	return true;
+}
+
+void table_store_close(TableStore& store) {
+	if (store.map) munmap(store.map, store.length);
+	store = TableStore();
+}
+
+mpz_srcptr table_store_entry(TableStore& store, long row, long col, mpz_t view) {
+	//Read-only mpz view of an entry, straight from the mapped file, (no copy)
+	long i = row * store.header->cols + col;
+	return mpz_roinit_n(view, store.limbs + store.offsets[i], store.sizes[i]);
+}
+
+void table_store_get_mat(TableStore& store, fmpz_mat_t matOut) {
+	//Copies the table into a new matrix - still just a copy of the limbs, (no parsing)
+	long rows = store.header->rows;
+	long cols = store.header->cols;
+	fmpz_mat_init(matOut, rows, cols);
+	mpz_t view;
+	for (long i = 0; i < rows; i++) {
+		for (long j = 0; j < cols; j++) {
+			fmpz_set_mpz(fmpz_mat_entry(matOut, i, j), table_store_entry(store, i, j, view));
+		}
+	}
+}
+
+void serialize_mat(const char* filename, fmpz_mat_t mat) {
+	//Note: This now writes the table store format, (without a key)
+	table_store_write(filename, mat, 0, 0, TABLE_ENGINE_RAW);
+}
+
+void deserialize_mat(const char* filename, fmpz_mat_t mat) {
+	TableStore store;
+	if (!table_store_open(filename, store, true)) {
+		perror("Could not open file for reading");
+		return;
+	}
+	table_store_get_mat(store, mat);
+	table_store_close(store);
 	//fmpz_mat_print_pretty(mat);
+}
+
+int rank_bits(int seqLen, int maxSym) {
+	//Bits in maxSym^seqLen - 1, (exact, unlike the log2 estimate in native_rank_bits)
+	fmpz_t largest;
+	fmpz_init(largest);
+	fmpz_ui_pow_ui(largest, maxSym, seqLen);
+	fmpz_sub_ui(largest, largest, 1);
+	int bits = fmpz_bits(largest);
+	fmpz_clear(largest);
+	return bits;
+}
+
+int rank_width(int seqLen, int maxSym) {
+	return std::max(1, (rank_bits(seqLen, maxSym) + FLINT_BITS - 1) / FLINT_BITS);
+}
+
+void rank_pack(fmpz_t rank, int width, mp_limb_t* limbsOut) {
+	//Straight out of the fmpz, (the rank has to fit the width)
+	fmpz_get_ui_array(limbsOut, width, rank);
+}
+
+bool rank_write(FILE* file, fmpz_t rank, int width) {
+	thread_local std::vector<mp_limb_t> limbs;
+	limbs.resize(width);
+	rank_pack(rank, width, limbs.data());
+	return fwrite(limbs.data(), sizeof(mp_limb_t), width, file) == (size_t)width;
+}
+
+mpz_srcptr rank_view(const mp_limb_t* limbs, int width, mpz_t view) {
+	//The high zero limbs are trimmed off by mpz_roinit_n, (as in table_store_entry)
+	return mpz_roinit_n(view, limbs, width);
+}
+
+void rank_unpack(const mp_limb_t* limbs, int width, fmpz_t rankOut) {
+	fmpz_set_ui_array(rankOut, limbs, width);
 }
\ No newline at end of file
@@ -2,12 +2,66 @@
 #include <iostream>
 #include <vector>
 #include <cstdint>
+#include <string>
+#include <cstdio>
 #include "flint/fmpz.h"
 #include "flint/fmpz_mat.h"
 
 
 void printVector(std::vector<uint8_t>& vals);
+void printVector(std::vector<uint16_t>& vals);
 void printVector(std::vector<int>& vals);
 
+//Table store - a versioned file of precomputed tables, (e.g. gen_rgf_table or gen_rgf_row), keyed by (n, k, engine).
+//The entries are kept as raw limbs, so a table can be memory mapped and used without parsing
+const char TABLE_STORE_MAGIC[8] = {'D', 'E', 'C', 'I', 'M', 'T', 'B', 'L'};
+const uint32_t TABLE_STORE_VERSION = 1;
+
+const int TABLE_ENGINE_RAW = 0; //No key, (see serialize_mat)
+const int TABLE_ENGINE_RGF_TABLE = 1;
+const int TABLE_ENGINE_RGF_ROW = 2;
+
+struct TableStoreHeader { //Followed by sizes[rows*cols], offsets[rows*cols], then the limbs
+	char magic[8];
+	uint32_t version;
+	uint32_t engine;
+	int64_t n;
+	int64_t k;
+	int64_t rows;
+	int64_t cols;
+	uint64_t limbCount;
+	uint64_t checksum; //Of everything after the header
+};
+
+struct TableStore {
+	//Read-only view of a table file mapped into memory.  Pages are only read in when they're touched, 
+	//and the mapping is shared with any other process that has the same file open
+	void* map = NULL;
+	size_t length = 0;
+	const TableStoreHeader* header = NULL;
+	const int64_t* sizes = NULL; //Signed limb count of each entry, (as in mpz)
+	const uint64_t* offsets = NULL; //Where each entry starts in limbs
+	const mp_limb_t* limbs = NULL;
+};
+
+FILE* open_temp_file(const char* filename, std::string& tempNameOut); //To rename over filename once it's written
+std::string table_store_path(const char* dir, int n, int k, int engine);
+bool table_store_write(const char* filename, fmpz_mat_t mat, int n, int k, int engine);
+bool table_store_open(const char* filename, TableStore& storeOut, bool verify = false); //Lazy unless verify, (which full copies should use)
+void table_store_close(TableStore& store);
+mpz_srcptr table_store_entry(TableStore& store, long row, long col, mpz_t view);
+void table_store_get_mat(TableStore& store, fmpz_mat_t matOut);
+uint64_t table_store_checksum(const uint64_t* words, size_t count, uint64_t hash);
+
 void serialize_mat(const char* filename, fmpz_mat_t mat);
-void deserialize_mat(const char* filename, fmpz_mat_t mat); 
\ No newline at end of file
+void deserialize_mat(const char* filename, fmpz_mat_t mat);
+
+//Rank codec - every rank for a (seqLen, maxSym) is below maxSym^seqLen, so they all fit the same number of limbs.
+//Ranks are written as exactly that many little-endian limbs, with no size prefix, so a run of them is just an array
+//that can be read in place, (e.g. from a mapped file)
+int rank_bits(int seqLen, int maxSym); //Of the largest rank
+int rank_width(int seqLen, int maxSym); //Limbs per rank
+void rank_pack(fmpz_t rank, int width, mp_limb_t* limbsOut); //Zero padded up to width
+bool rank_write(FILE* file, fmpz_t rank, int width);
+mpz_srcptr rank_view(const mp_limb_t* limbs, int width, mpz_t view); //Read-only, (no copy)
+void rank_unpack(const mp_limb_t* limbs, int width, fmpz_t rankOut);
\ No newline at end of file
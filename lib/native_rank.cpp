@@ -0,0 +1,629 @@
+#include "native_rank.h"
+#include "near_entropic.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+const int INVALID = -1;
+
+bool nativeEngine = true;
+
+void set_native_engine(bool enabled) {
+	nativeEngine = enabled;
+}
+bool get_native_engine() {
+	return nativeEngine;
+}
+
+int native_rank_bits(int seqLen, int maxSym) {
+	//Every rank is below maxSym^seqLen, (all the symbol sections together).
+	//The alphabet is capped at SMALL_SYM_MAX so the comb and perm sections stay in a uint64_t
+	if (seqLen < 1 || seqLen > NATIVE_MAX_LEN || maxSym < 1 || maxSym > SMALL_SYM_MAX) return NATIVE_MAX_BITS+1;
+	return (int)std::ceil(seqLen * std::log2(maxSym) + 1e-9); //(Rounds an exact power of two up a bit)
+}
+
+struct NativeDivisor {
+	//Divides by a multiply and shifts, (Granlund and Montgomery's round-up method, which is exact for every 64 bit numerator)
+	uint64_t divisor;
+	uint64_t magic;
+	int shift1;
+	int shift2;
+};
+
+NativeDivisor native_divisor(uint64_t divisor) {
+	int l = 0;
+	while (l < 64 && ((uint128_t)1 << l) < divisor) l++; //ceil(log2(divisor))
+	NativeDivisor div;
+	div.divisor = divisor;
+	div.magic = (uint64_t)(((((uint128_t)1 << l) - divisor) << 64) / divisor) + 1;
+	div.shift1 = std::min(l, 1);
+	div.shift2 = std::max(l-1, 0);
+	return div;
+}
+
+inline uint64_t native_divide(uint64_t n, const NativeDivisor& div) {
+	uint64_t t = ((uint128_t)div.magic * n) >> 64;
+	return (t + ((n - t) >> div.shift1)) >> div.shift2;
+}
+
+//GCC 12's unroll-and-jam at -O3 fuses the rows of the UInt256 table recurrence, although each row reads the one before it.
+//The tables are built in fmpz because of it, and the rank loops are kept out of it too, (they aren't jammed today, but the unrank is a nest)
+#if defined(__GNUC__) && !defined(__clang__)
+#define NATIVE_NO_JAM __attribute__((optimize("no-loop-unroll-and-jam")))
+#else
+#define NATIVE_NO_JAM
+#endif
+
+//The tables for the last few block sizes on this thread, (one cache for each width).
+//Every k is built at once, so records using different numbers of symbols share them, and a K search's lengths all stay cached
+const int NATIVE_TABLE_SLOTS = 8;
+
+template <typename UInt>
+struct NativeTables {
+	int seqLen = INVALID;
+	int maxSym = INVALID;
+	uint64_t lastUse = 0;
+	std::vector<UInt> sections; //Cumulative, (entry k holds the size of all the sections using 1..k symbols)
+	std::vector<UInt> rgf; //Every k, rgf[(k*seqLen + remLen)*(maxSym+2) + currentMax], (the same counts as gen_rgf_table)
+	std::vector<NativeDivisor> stirDivisors; //By k, (the batches divide by the section sizes without a divide instruction)
+	std::vector<NativeDivisor> combDivisors;
+};
+
+template <typename UInt>
+struct NativeTableCache {
+	NativeTables<UInt> slots[NATIVE_TABLE_SLOTS];
+	uint64_t useCount = 0;
+};
+template <typename UInt>
+thread_local NativeTableCache<UInt> nativeTableCache;
+
+template <typename UInt>
+void build_native_tables(int seqLen, int maxSym, NativeTables<UInt>& tables) {
+	//Built through fmpz and narrowed, (only once per block size - see NATIVE_NO_JAM)
+	fmpz_mat_t sections;
+	gen_symbol_sections(seqLen, maxSym, sections);
+	tables.sections.resize(maxSym+1);
+	for (int k = 0; k <= maxSym; k++) {
+		native_from_fmpz(fmpz_mat_entry(sections, 0, k), tables.sections[k]);
+	}
+	fmpz_mat_clear(sections);
+
+	//See gen_rgf_table, two fmpz rows at a time
+	int n = seqLen;
+	int cols = maxSym+2;
+	tables.rgf.assign((maxSym+1)*n*cols, UInt(0));
+	tables.stirDivisors.resize(maxSym+1);
+	tables.combDivisors.resize(maxSym+1);
+	fmpz* prev = _fmpz_vec_init(cols);
+	fmpz* cur = _fmpz_vec_init(cols);
+	for (int k = 1; k <= maxSym; k++) {
+		UInt* table = &tables.rgf[k*n*cols];
+		for (int m = 0; m < cols; m++) fmpz_zero(prev+m);
+		fmpz_one(prev+k);
+		table[k] = UInt(1);
+		for (int len = 1; len < n; len++) {
+			for (int m = 1; m <= k; m++) {
+				fmpz_mul_ui(cur+m, prev+m, m);
+				fmpz_add(cur+m, cur+m, prev+m+1);
+				native_from_fmpz(cur+m, table[len*cols + m]);
+			}
+			std::swap(prev, cur);
+		}
+		tables.stirDivisors[k] = native_divisor(PASCAL.c[maxSym][k] * FACTS.f[k]); //(At most 20!)
+		tables.combDivisors[k] = native_divisor(FACTS.f[k]);
+	}
+	_fmpz_vec_clear(prev, cols);
+	_fmpz_vec_clear(cur, cols);
+	tables.seqLen = seqLen;
+	tables.maxSym = maxSym;
+}
+
+template <typename UInt>
+NativeTables<UInt>& get_native_tables(int seqLen, int maxSym) {
+	NativeTableCache<UInt>& cache = nativeTableCache<UInt>;
+	cache.useCount++;
+	NativeTables<UInt>* oldest = &cache.slots[0];
+	for (NativeTables<UInt>& tables : cache.slots) {
+		if (tables.seqLen == seqLen && tables.maxSym == maxSym) {
+			tables.lastUse = cache.useCount;
+			return tables;
+		}
+		if (tables.lastUse < oldest->lastUse) oldest = &tables;
+	}
+
+	//Not cached, so the least recently used slot is rebuilt
+	build_native_tables(seqLen, maxSym, *oldest);
+	oldest->lastUse = cache.useCount;
+	return *oldest;
+}
+
+template <typename UInt, typename Sym>
+NATIVE_NO_JAM void native_near_rank(std::vector<Sym>& valSeq, int maxSym, UInt& rankOut) {
+	//Same steps as near_entropic_rank
+	int seqLen = valSeq.size();
+
+	int valToSym[SMALL_SYM_MAX];
+	std::fill(valToSym, valToSym + maxSym, INVALID);
+	uint8_t rgfSeq[NATIVE_MAX_LEN];
+	int symCount = 0;
+	for (int i = 0; i < seqLen; i++) {
+		int val = valSeq[i];
+		if (valToSym[val] == INVALID) valToSym[val] = symCount++; //First time this symbol has been seen
+		rgfSeq[i] = valToSym[val] + 1; //RGF is 1-indexed
+	}
+
+	//Permutation of symbols -> vals
+	uint8_t vals[SMALL_SYM_MAX];
+	uint8_t symPerm[SMALL_SYM_MAX];
+	for (int i = 0, s = 0; i < maxSym; i++) {
+		if (valToSym[i] != INVALID) {
+			vals[s] = i;
+			symPerm[s] = valToSym[i];
+			s++;
+		}
+	}
+
+	NativeTables<UInt>& tables = get_native_tables<UInt>(seqLen, maxSym);
+	int cols = maxSym+2;
+	const UInt* rgfTable = &tables.rgf[symCount*seqLen*cols];
+
+	// 1. Add symbol sections
+	rankOut = tables.sections[symCount-1];
+
+	// 2. Add Set Partition / Stirling2 rank, (see rgf_rank_table)
+	UInt stirRank = UInt(0);
+	int currentMax = 1;
+	for (int i = 1; i < seqLen; i++) {
+		int remLen = seqLen - 1 - i;
+		int digit = rgfSeq[i];
+		const UInt& weight = rgfTable[remLen*cols + currentMax];
+		if (digit == currentMax+1) {
+			stirRank += weight * (uint64_t)currentMax;
+			currentMax++;
+		}
+		else stirRank += weight * (uint64_t)(digit-1);
+	}
+	uint64_t combSectionSize = FACTS.f[symCount];
+	uint64_t stirSectionSize = comb(maxSym, symCount) * combSectionSize; //(At most 20!)
+	rankOut += stirRank * stirSectionSize;
+
+	// 3. Add the combination rank
+	uint64_t combRank = 0;
+	for (int i = 0; i < symCount; i++) {
+		combRank += comb(vals[symCount-1-i], symCount-i);
+	}
+	rankOut += UInt(combRank * combSectionSize);
+
+	// 4. Add the Sym Perm Rank (Myrvold)
+	rankOut += UInt(myrvold_rank_ui(symPerm, symCount));
+}
+
+template <typename UInt, typename Sym>
+NATIVE_NO_JAM bool native_near_unrank(UInt rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy) {
+	//Same steps as near_entropic_unrank.  The sequences are short, so the entropy bound is only checked at the end
+	NativeTables<UInt>& tables = get_native_tables<UInt>(seqLen, maxSym);
+
+	// 1. Get symbol section
+	int lo = 1;
+	int hi = maxSym;
+	while (lo < hi) {
+		int mid = (lo+hi)/2;
+		if (rank < tables.sections[mid]) hi = mid;
+		else lo = mid+1;
+	}
+	rank -= tables.sections[lo-1];
+	int symCount = lo;
+	int cols = maxSym+2;
+	const UInt* rgfTable = &tables.rgf[symCount*seqLen*cols];
+
+	uint64_t combSectionSize = FACTS.f[symCount];
+	uint64_t stirSectionSize = comb(maxSym, symCount) * combSectionSize;
+	uint64_t rankModStir = native_divmod_ui(rank, stirSectionSize); //(The rank is left as the stir rank)
+
+	// 2. Get the values from the combination rank of symbols, (see comb_unrank)
+	uint64_t combRank = rankModStir / combSectionSize;
+	uint8_t combVals[SMALL_SYM_MAX];
+	int n = maxSym;
+	for (int i = 0; i < symCount; i++) {
+		while (comb(n, symCount-i) > combRank) n--;
+		combVals[symCount-i-1] = n;
+		combRank -= comb(n, symCount-i);
+	}
+
+	// 3. Get the Sym Perm from Myrvold Rank
+	uint8_t symPerm[SMALL_SYM_MAX];
+	uint8_t invPerm[SMALL_SYM_MAX];
+	myrvold_unrank_ui(rankModStir % combSectionSize, symPerm, symCount);
+	for (int i = 0; i < symCount; i++) {
+		invPerm[symPerm[i]] = i;
+	}
+
+	// 4. Get the Set Partition from Stirling2 rank, (see rgf_unrank_table), and apply the inverse perm as it goes
+	int counts[SMALL_SYM_MAX] = {};
+	valSeqOut[0] = combVals[invPerm[0]];
+	counts[0]++;
+	int currentMax = 1;
+	for (int i = 1; i < seqLen; i++) {
+		int remLen = seqLen - 1 - i;
+		const UInt& weightStay = rgfTable[remLen*cols + currentMax];
+		UInt countStay = weightStay * (uint64_t)currentMax;
+		int digit;
+		if (rank < countStay) { //Stay with existing block, (at most currentMax-1 steps)
+			digit = 1;
+			while (!(rank < weightStay)) {
+				rank -= weightStay;
+				digit++;
+			}
+		}
+		else { //Create new block
+			rank -= countStay;
+			currentMax++;
+			digit = currentMax;
+		}
+		valSeqOut[i] = combVals[invPerm[digit-1]];
+		counts[digit-1]++;
+	}
+
+	double countSum = 0.0;
+	for (int s = 0; s < symCount; s++) {
+		countsOut[s] += counts[s];
+		if (counts[s] > 1) countSum += counts[s] * std::log2(counts[s]);
+	}
+	if (maxEntropy < NO_ENTROPY_BOUND && seqLen * std::log2(seqLen) - countSum > maxEntropy + ENTROPY_EPS) return false;
+	return true;
+}
+
+template <typename Sym>
+bool near_native_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut) {
+	if (!nativeEngine) return false;
+	int bits = native_rank_bits(valSeq.size(), maxSym);
+	if (bits <= 64) {
+		uint64_t rank;
+		native_near_rank(valSeq, maxSym, rank);
+		native_to_fmpz(rank, rankOut);
+	}
+	else if (bits <= 128) {
+		uint128_t rank;
+		native_near_rank(valSeq, maxSym, rank);
+		native_to_fmpz(rank, rankOut);
+	}
+	else if (bits <= NATIVE_MAX_BITS) {
+		UInt256 rank;
+		native_near_rank(valSeq, maxSym, rank);
+		native_to_fmpz(rank, rankOut);
+	}
+	else return false;
+	return true;
+}
+
+template <typename Sym>
+bool near_native_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy, bool& completedOut) {
+	if (!nativeEngine) return false;
+	int bits = native_rank_bits(seqLen, maxSym);
+	if (bits <= 64) {
+		uint64_t nativeRank;
+		native_from_fmpz(rank, nativeRank);
+		completedOut = native_near_unrank(nativeRank, seqLen, maxSym, countsOut, valSeqOut, maxEntropy);
+	}
+	else if (bits <= 128) {
+		uint128_t nativeRank;
+		native_from_fmpz(rank, nativeRank);
+		completedOut = native_near_unrank(nativeRank, seqLen, maxSym, countsOut, valSeqOut, maxEntropy);
+	}
+	else if (bits <= NATIVE_MAX_BITS) {
+		UInt256 nativeRank;
+		native_from_fmpz(rank, nativeRank);
+		completedOut = native_near_unrank(nativeRank, seqLen, maxSym, countsOut, valSeqOut, maxEntropy);
+	}
+	else return false;
+	fmpz_zero(rank); //(As the fmpz path leaves it)
+	return true;
+}
+
+//---- Batches ----
+//Every lane takes the same steps, (the branches are folded into selects).  The RGF loops, (where the time goes), 
+//run in AVX-512 or AVX2 registers when the build targets them, with gathers for the table lookups, and fall back to scalar loops
+typedef uint8_t LaneDigits[NATIVE_BATCH_LANES]; //One position of the RGF for every lane
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+//(The masked forms all have every lane set - the unmasked ones trip GCC's uninitialized warnings)
+void native_rgf_rank_lanes(const LaneDigits* rgf, int seqLen, int cols, const uint64_t* tableBase, const uint64_t* rgfAll, uint64_t* stirRankOut) {
+	__m512i one = _mm512_set1_epi64(1);
+	__m512i base = _mm512_loadu_si512(tableBase);
+	__m512i currentMax = one;
+	__m512i stirRank = _mm512_setzero_si512();
+	for (int i = 1; i < seqLen; i++) {
+		__m512i row = _mm512_add_epi64(base, _mm512_set1_epi64((seqLen-1-i)*cols));
+		__m512i weight = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, _mm512_add_epi64(row, currentMax), (const void*)rgfAll, 8);
+		__m512i digit = _mm512_maskz_cvtepu8_epi64(0xFF, _mm_loadl_epi64((const __m128i*)rgf[i]));
+		__mmask8 isNew = _mm512_cmpeq_epi64_mask(digit, _mm512_add_epi64(currentMax, one));
+		__m512i skipped = _mm512_mask_blend_epi64(isNew, _mm512_sub_epi64(digit, one), currentMax);
+		stirRank = _mm512_add_epi64(stirRank, _mm512_mullo_epi64(weight, skipped));
+		currentMax = _mm512_mask_add_epi64(currentMax, isNew, currentMax, one);
+	}
+	_mm512_storeu_si512(stirRankOut, stirRank);
+}
+
+void native_rgf_unrank_lanes(uint64_t* stirRank, int seqLen, int maxSym, int cols, const uint64_t* tableBase, const uint64_t* rgfAll, LaneDigits* rgfOut) {
+	__m512i one = _mm512_set1_epi64(1);
+	__m512i base = _mm512_loadu_si512(tableBase);
+	__m512i currentMax = one;
+	__m512i rank = _mm512_loadu_si512(stirRank);
+	for (int i = 1; i < seqLen; i++) {
+		__m512i row = _mm512_add_epi64(base, _mm512_set1_epi64((seqLen-1-i)*cols));
+		__m512i weight = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, _mm512_add_epi64(row, currentMax), (const void*)rgfAll, 8);
+		//The quotient is below currentMax, so it's counted up in multiples of the weight, (there's no vector divide)
+		__m512i multiple = _mm512_setzero_si512();
+		__m512i quot = _mm512_setzero_si512();
+		__m512i taken = _mm512_setzero_si512();
+		__m512i countStay = _mm512_setzero_si512();
+		for (int j = 1; j <= maxSym; j++) {
+			multiple = _mm512_add_epi64(multiple, weight);
+			__m512i jVec = _mm512_set1_epi64(j);
+			__mmask8 fits = _mm512_cmplt_epu64_mask(jVec, currentMax) & _mm512_cmple_epu64_mask(multiple, rank);
+			quot = _mm512_mask_add_epi64(quot, fits, quot, one);
+			taken = _mm512_mask_mov_epi64(taken, fits, multiple);
+			countStay = _mm512_mask_mov_epi64(countStay, _mm512_cmpeq_epi64_mask(jVec, currentMax), multiple);
+		}
+		__mmask8 stay = _mm512_cmplt_epu64_mask(rank, countStay);
+		__m512i digit = _mm512_mask_blend_epi64(stay, _mm512_add_epi64(currentMax, one), _mm512_add_epi64(quot, one));
+		rank = _mm512_sub_epi64(rank, _mm512_mask_blend_epi64(stay, countStay, taken));
+		currentMax = _mm512_mask_add_epi64(currentMax, ~stay, currentMax, one);
+		_mm_storel_epi64((__m128i*)rgfOut[i], _mm512_maskz_cvtepi64_epi8(0xFF, digit));
+	}
+}
+
+#elif defined(__AVX2__)
+inline __m256i mul_lo32(__m256i a, __m256i b) { //64 bit a times b, (b below 2^32)
+	__m256i lo = _mm256_mul_epu32(a, b);
+	__m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+	return _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+}
+
+inline __m256i cmpgt_epu64(__m256i a, __m256i b) { //Unsigned, by flipping the sign bits
+	__m256i sign = _mm256_set1_epi64x(INT64_MIN);
+	return _mm256_cmpgt_epi64(_mm256_xor_si256(a, sign), _mm256_xor_si256(b, sign));
+}
+
+inline __m256i load_digits(const uint8_t* digits) {
+	int32_t packed;
+	std::memcpy(&packed, digits, sizeof(packed));
+	return _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(packed));
+}
+
+void native_rgf_rank_lanes(const LaneDigits* rgf, int seqLen, int cols, const uint64_t* tableBase, const uint64_t* rgfAll, uint64_t* stirRankOut) {
+	__m256i one = _mm256_set1_epi64x(1);
+	for (int half = 0; half < NATIVE_BATCH_LANES; half += 4) { //(Two registers of four lanes)
+		__m256i base = _mm256_loadu_si256((const __m256i*)(tableBase + half));
+		__m256i currentMax = one;
+		__m256i stirRank = _mm256_setzero_si256();
+		for (int i = 1; i < seqLen; i++) {
+			__m256i row = _mm256_add_epi64(base, _mm256_set1_epi64x((seqLen-1-i)*cols));
+			__m256i weight = _mm256_i64gather_epi64((const long long*)rgfAll, _mm256_add_epi64(row, currentMax), 8);
+			__m256i digit = load_digits(rgf[i] + half);
+			__m256i isNew = _mm256_cmpeq_epi64(digit, _mm256_add_epi64(currentMax, one));
+			__m256i skipped = _mm256_blendv_epi8(_mm256_sub_epi64(digit, one), currentMax, isNew);
+			stirRank = _mm256_add_epi64(stirRank, mul_lo32(weight, skipped));
+			currentMax = _mm256_sub_epi64(currentMax, isNew); //(isNew is all ones, or -1)
+		}
+		_mm256_storeu_si256((__m256i*)(stirRankOut + half), stirRank);
+	}
+}
+
+void native_rgf_unrank_lanes(uint64_t* stirRank, int seqLen, int maxSym, int cols, const uint64_t* tableBase, const uint64_t* rgfAll, LaneDigits* rgfOut) {
+	__m256i one = _mm256_set1_epi64x(1);
+	for (int half = 0; half < NATIVE_BATCH_LANES; half += 4) {
+		__m256i base = _mm256_loadu_si256((const __m256i*)(tableBase + half));
+		__m256i currentMax = one;
+		__m256i rank = _mm256_loadu_si256((const __m256i*)(stirRank + half));
+		for (int i = 1; i < seqLen; i++) {
+			__m256i row = _mm256_add_epi64(base, _mm256_set1_epi64x((seqLen-1-i)*cols));
+			__m256i weight = _mm256_i64gather_epi64((const long long*)rgfAll, _mm256_add_epi64(row, currentMax), 8);
+			//The quotient is below currentMax, so it's counted up in multiples of the weight, (there's no vector divide)
+			__m256i multiple = _mm256_setzero_si256();
+			__m256i quot = _mm256_setzero_si256();
+			__m256i taken = _mm256_setzero_si256();
+			__m256i countStay = _mm256_setzero_si256();
+			for (int j = 1; j <= maxSym; j++) {
+				multiple = _mm256_add_epi64(multiple, weight);
+				__m256i jVec = _mm256_set1_epi64x(j);
+				__m256i fits = _mm256_andnot_si256(cmpgt_epu64(multiple, rank), _mm256_cmpgt_epi64(currentMax, jVec));
+				quot = _mm256_sub_epi64(quot, fits);
+				taken = _mm256_blendv_epi8(taken, multiple, fits);
+				countStay = _mm256_blendv_epi8(countStay, multiple, _mm256_cmpeq_epi64(jVec, currentMax));
+			}
+			__m256i stay = cmpgt_epu64(countStay, rank);
+			__m256i digit = _mm256_blendv_epi8(_mm256_add_epi64(currentMax, one), _mm256_add_epi64(quot, one), stay);
+			rank = _mm256_sub_epi64(rank, _mm256_blendv_epi8(countStay, taken, stay));
+			currentMax = _mm256_add_epi64(currentMax, _mm256_andnot_si256(stay, one));
+			uint64_t digits[4];
+			_mm256_storeu_si256((__m256i*)digits, digit);
+			for (int lane = 0; lane < 4; lane++) rgfOut[i][half + lane] = digits[lane];
+		}
+	}
+}
+
+#else
+void native_rgf_rank_lanes(const LaneDigits* rgf, int seqLen, int cols, const uint64_t* tableBase, const uint64_t* rgfAll, uint64_t* stirRankOut) {
+	//Same steps as rgf_rank_table
+	for (int lane = 0; lane < NATIVE_BATCH_LANES; lane++) {
+		uint64_t currentMax = 1;
+		uint64_t stirRank = 0;
+		for (int i = 1; i < seqLen; i++) {
+			uint64_t digit = rgf[i][lane];
+			uint64_t weight = rgfAll[tableBase[lane] + (seqLen-1-i)*cols + currentMax];
+			uint64_t isNew = (digit == currentMax+1);
+			stirRank += weight * (isNew? currentMax : digit-1);
+			currentMax += isNew;
+		}
+		stirRankOut[lane] = stirRank;
+	}
+}
+
+void native_rgf_unrank_lanes(uint64_t* stirRank, int seqLen, int maxSym, int cols, const uint64_t* tableBase, const uint64_t* rgfAll, LaneDigits* rgfOut) {
+	//Same steps as rgf_unrank_table
+	for (int lane = 0; lane < NATIVE_BATCH_LANES; lane++) {
+		uint64_t currentMax = 1;
+		uint64_t rank = stirRank[lane];
+		for (int i = 1; i < seqLen; i++) {
+			uint64_t weight = rgfAll[tableBase[lane] + (seqLen-1-i)*cols + currentMax];
+			uint64_t countStay = weight * currentMax;
+			if (rank < countStay) {
+				rgfOut[i][lane] = rank / weight + 1;
+				rank %= weight;
+			}
+			else {
+				rank -= countStay;
+				currentMax++;
+				rgfOut[i][lane] = currentMax;
+			}
+		}
+	}
+}
+#endif
+
+void native_near_rank_lanes(const uint8_t* seqs, int stride, int seqLen, int maxSym, NativeTables<uint64_t>& tables, const uint64_t* rgfAll, uint64_t* ranksOut) {
+	const int L = NATIVE_BATCH_LANES;
+	int cols = maxSym+2;
+	
+	//Symbols in order of first appearance, (stored +1, so 0 is unseen, and the RGF digit falls straight out)
+	uint8_t valToSym[SMALL_SYM_MAX][L] = {};
+	LaneDigits rgf[NATIVE_MAX_LEN];
+	uint8_t symCount[L] = {};
+	for (int i = 0; i < seqLen; i++) {
+		for (int lane = 0; lane < L; lane++) {
+			int val = seqs[i*stride + lane];
+			uint8_t sym = valToSym[val][lane];
+			uint8_t isNew = (sym == 0);
+			symCount[lane] += isNew;
+			sym = isNew? symCount[lane] : sym;
+			valToSym[val][lane] = sym;
+			rgf[i][lane] = sym;
+		}
+	}
+	
+	uint64_t tableBase[L];
+	for (int lane = 0; lane < L; lane++) tableBase[lane] = symCount[lane]*seqLen*cols;
+	uint64_t stirRank[L];
+	native_rgf_rank_lanes(rgf, seqLen, cols, tableBase, rgfAll, stirRank);
+	
+	//The symbol sections, and the comb and perm ranks are a handful of steps per record
+	for (int lane = 0; lane < L; lane++) {
+		int k = symCount[lane];
+		uint8_t vals[SMALL_SYM_MAX];
+		uint8_t symPerm[SMALL_SYM_MAX];
+		uint64_t combRank = 0;
+		for (int val = 0, s = 0; val < maxSym; val++) { //(Written either way, and only kept if the val is used)
+			vals[s] = val;
+			symPerm[s] = valToSym[val][lane] - 1;
+			s += (valToSym[val][lane] != 0);
+		}
+		for (int i = 0; i < k; i++) {
+			combRank += PASCAL.c[vals[k-1-i]][k-i];
+		}
+		uint64_t combSectionSize = FACTS.f[k];
+		uint64_t stirSectionSize = PASCAL.c[maxSym][k] * combSectionSize;
+		ranksOut[lane] = tables.sections[k-1] + stirRank[lane]*stirSectionSize + combRank*combSectionSize + myrvold_rank_ui(symPerm, k);
+	}
+}
+
+void native_near_unrank_lanes(const uint64_t* ranks, int seqLen, int maxSym, NativeTables<uint64_t>& tables, const uint64_t* rgfAll, uint8_t* seqsOut, int stride) {
+	const int L = NATIVE_BATCH_LANES;
+	int cols = maxSym+2;
+	
+	uint64_t stirRank[L];
+	uint64_t tableBase[L];
+	uint8_t symToVal[L][SMALL_SYM_MAX+1]; //Indexed by RGF digit
+	for (int lane = 0; lane < L; lane++) {
+		uint64_t rank = ranks[lane];
+		int k = 1;
+		for (int j = 1; j < maxSym; j++) k += (rank >= tables.sections[j]); //(The sections are cumulative)
+		rank -= tables.sections[k-1];
+		const NativeDivisor& stirDiv = tables.stirDivisors[k];
+		const NativeDivisor& combDiv = tables.combDivisors[k];
+		stirRank[lane] = native_divide(rank, stirDiv);
+		uint64_t rankModStir = rank - stirRank[lane]*stirDiv.divisor;
+		
+		uint64_t combRank = native_divide(rankModStir, combDiv);
+		uint64_t symRank = rankModStir - combRank*combDiv.divisor;
+		uint8_t combVals[SMALL_SYM_MAX+1]; //combVals[t] is the val for digit t, (see comb_unrank)
+		for (int v = maxSym-1, t = k; v >= 0; v--) {
+			int take = (t > 0) & (PASCAL.c[v][t] <= combRank);
+			combVals[t] = take? v : combVals[t];
+			combRank -= take? PASCAL.c[v][t] : 0;
+			t -= take;
+		}
+		uint8_t symPerm[SMALL_SYM_MAX];
+		myrvold_unrank_ui(symRank, symPerm, k);
+		for (int i = 0; i < k; i++) {
+			symToVal[lane][symPerm[i]+1] = combVals[i+1]; //(The inverse perm, applied to the vals)
+		}
+		tableBase[lane] = k*seqLen*cols;
+	}
+	
+	LaneDigits rgf[NATIVE_MAX_LEN];
+	native_rgf_unrank_lanes(stirRank, seqLen, maxSym, cols, tableBase, rgfAll, rgf);
+	for (int lane = 0; lane < L; lane++) seqsOut[lane] = symToVal[lane][1]; //(The RGF always starts with 1)
+	for (int i = 1; i < seqLen; i++) {
+		for (int lane = 0; lane < L; lane++) {
+			seqsOut[i*stride + lane] = symToVal[lane][rgf[i][lane]];
+		}
+	}
+}
+
+bool near_rank_batch(const uint8_t* seqs, int count, int seqLen, int maxSym, uint64_t* ranksOut) {
+	if (native_rank_bits(seqLen, maxSym) > 64) return false;
+	NativeTables<uint64_t>& tables = get_native_tables<uint64_t>(seqLen, maxSym);
+	const uint64_t* rgfAll = tables.rgf.data();
+	const int L = NATIVE_BATCH_LANES;
+	int full = count - count % L;
+	for (int r = 0; r < full; r += L) {
+		native_near_rank_lanes(seqs + r, count, seqLen, maxSym, tables, rgfAll, ranksOut + r);
+	}
+	if (full < count) { //The tail is padded out with all-zero records
+		uint8_t pad[NATIVE_MAX_LEN*L] = {};
+		uint64_t padRanks[L];
+		for (int i = 0; i < seqLen; i++) {
+			std::copy(seqs + i*count + full, seqs + (i+1)*count, pad + i*L);
+		}
+		native_near_rank_lanes(pad, L, seqLen, maxSym, tables, rgfAll, padRanks);
+		std::copy(padRanks, padRanks + (count-full), ranksOut + full);
+	}
+	return true;
+}
+
+bool near_unrank_batch(const uint64_t* ranks, int count, int seqLen, int maxSym, uint8_t* seqsOut) {
+	if (native_rank_bits(seqLen, maxSym) > 64) return false;
+	NativeTables<uint64_t>& tables = get_native_tables<uint64_t>(seqLen, maxSym);
+	const uint64_t* rgfAll = tables.rgf.data();
+	const int L = NATIVE_BATCH_LANES;
+	int full = count - count % L;
+	for (int r = 0; r < full; r += L) {
+		native_near_unrank_lanes(ranks + r, seqLen, maxSym, tables, rgfAll, seqsOut + r, count);
+	}
+	if (full < count) {
+		uint8_t pad[NATIVE_MAX_LEN*L];
+		uint64_t padRanks[L] = {};
+		std::copy(ranks + full, ranks + count, padRanks);
+		native_near_unrank_lanes(padRanks, seqLen, maxSym, tables, rgfAll, pad, L);
+		for (int i = 0; i < seqLen; i++) {
+			std::copy(pad + i*L, pad + i*L + (count-full), seqsOut + i*count + full);
+		}
+	}
+	return true;
+}
+
+#define NATIVE_INSTANTIATE_WIDTH(UInt, Sym) \
+	template void native_near_rank(std::vector<Sym>& valSeq, int maxSym, UInt& rankOut); \
+	template bool native_near_unrank(UInt rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy);
+#define NATIVE_INSTANTIATE(Sym) \
+	NATIVE_INSTANTIATE_WIDTH(uint64_t, Sym) \
+	NATIVE_INSTANTIATE_WIDTH(uint128_t, Sym) \
+	NATIVE_INSTANTIATE_WIDTH(UInt256, Sym) \
+	template bool near_native_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut); \
+	template bool near_native_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy, bool& completedOut);
+NATIVE_INSTANTIATE(uint8_t)
+NATIVE_INSTANTIATE(uint16_t)
\ No newline at end of file
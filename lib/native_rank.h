@@ -0,0 +1,112 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "flint/fmpz.h"
+#include "base_lib.h"
+#include "combinations.h"
+#include "permutations.h"
+
+//Fixed-width engine for short blocks, where every rank fits in 64, 128, or 256 bits.
+//Same order as near_entropic, but it works in native integers with no allocations, (after the first block of a size)
+const int NATIVE_MAX_BITS = 256;
+const int NATIVE_MAX_LEN = 256; //(Only a binary alphabet gets this long in 256 bits)
+const int NATIVE_BATCH_LANES = 8; //Records ranked side by side, (one AVX-512 register of uint64_t, or two AVX2 ones)
+
+typedef unsigned __int128 uint128_t;
+
+struct UInt256 {
+	uint64_t limbs[4]; //Little-endian
+
+	UInt256(uint64_t val = 0) : limbs{val, 0, 0, 0} {}
+};
+
+inline UInt256 operator+(const UInt256& a, const UInt256& b) {
+	UInt256 res;
+	uint64_t carry = 0;
+	for (int i = 0; i < 4; i++) {
+		uint128_t sum = (uint128_t)a.limbs[i] + b.limbs[i] + carry;
+		res.limbs[i] = (uint64_t)sum;
+		carry = sum >> 64;
+	}
+	return res;
+}
+
+inline UInt256 operator-(const UInt256& a, const UInt256& b) {
+	UInt256 res;
+	uint64_t borrow = 0;
+	for (int i = 0; i < 4; i++) {
+		uint64_t diff = a.limbs[i] - b.limbs[i];
+		uint64_t nextBorrow = (a.limbs[i] < b.limbs[i]) || (diff < borrow);
+		res.limbs[i] = diff - borrow;
+		borrow = nextBorrow;
+	}
+	return res;
+}
+
+inline UInt256 operator*(const UInt256& a, uint64_t b) {
+	UInt256 res;
+	uint64_t carry = 0;
+	for (int i = 0; i < 4; i++) {
+		uint128_t prod = (uint128_t)a.limbs[i] * b + carry;
+		res.limbs[i] = (uint64_t)prod;
+		carry = prod >> 64;
+	}
+	return res;
+}
+
+inline UInt256& operator+=(UInt256& a, const UInt256& b) { return a = a + b; }
+inline UInt256& operator-=(UInt256& a, const UInt256& b) { return a = a - b; }
+
+inline bool operator<(const UInt256& a, const UInt256& b) {
+	for (int i = 3; i >= 0; i--) {
+		if (a.limbs[i] != b.limbs[i]) return a.limbs[i] < b.limbs[i];
+	}
+	return false;
+}
+inline bool operator>=(const UInt256& a, const UInt256& b) { return !(a < b); }
+
+//Divides in place and returns the remainder, (the divisors are all section sizes below 20!)
+inline uint64_t native_divmod_ui(uint64_t& a, uint64_t d) { uint64_t r = a % d; a /= d; return r; }
+inline uint64_t native_divmod_ui(uint128_t& a, uint64_t d) { uint64_t r = a % d; a /= d; return r; }
+inline uint64_t native_divmod_ui(UInt256& a, uint64_t d) {
+	uint64_t r = 0;
+	for (int i = 3; i >= 0; i--) {
+		uint128_t cur = ((uint128_t)r << 64) | a.limbs[i];
+		a.limbs[i] = (uint64_t)(cur / d);
+		r = (uint64_t)(cur % d);
+	}
+	return r;
+}
+
+inline void native_to_fmpz(uint64_t a, fmpz_t out) { fmpz_set_ui(out, a); }
+inline void native_to_fmpz(uint128_t a, fmpz_t out) { fmpz_set_uiui(out, (uint64_t)(a >> 64), (uint64_t)a); }
+inline void native_to_fmpz(const UInt256& a, fmpz_t out) { fmpz_set_ui_array(out, (const ulong*)a.limbs, 4); }
+
+inline void native_from_fmpz(fmpz_t a, uint64_t& out) { out = fmpz_get_ui(a); }
+inline void native_from_fmpz(fmpz_t a, uint128_t& out) {
+	ulong limbs[2];
+	fmpz_get_ui_array(limbs, 2, a);
+	out = ((uint128_t)limbs[1] << 64) | limbs[0];
+}
+inline void native_from_fmpz(fmpz_t a, UInt256& out) { fmpz_get_ui_array((ulong*)out.limbs, 4, a); }
+
+void set_native_engine(bool enabled); //On by default, (off forces the fmpz path)
+bool get_native_engine();
+int native_rank_bits(int seqLen, int maxSym); //Bits needed to hold every rank, (past NATIVE_MAX_BITS if the native engine can't take it)
+
+template <typename UInt, typename Sym>
+void native_near_rank(std::vector<Sym>& valSeq, int maxSym, UInt& rankOut);
+template <typename UInt, typename Sym>
+bool native_near_unrank(UInt rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy);
+
+//Picks the narrowest width that fits, and returns false if the block is too big for any of them
+template <typename Sym>
+bool near_native_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut);
+template <typename Sym>
+bool near_native_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy, bool& completedOut);
+
+//Batches of short records whose ranks fit in 64 bits, (false otherwise).  The records are in structure-of-arrays
+//layout, so symbol i of record r is at seqs[i*count + r], and the ranks line up with the records
+bool near_rank_batch(const uint8_t* seqs, int count, int seqLen, int maxSym, uint64_t* ranksOut);
+bool near_unrank_batch(const uint64_t* ranks, int count, int seqLen, int maxSym, uint8_t* seqsOut);
\ No newline at end of file
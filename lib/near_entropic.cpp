@@ -1,58 +1,94 @@
 #include "near_entropic.h"
+#include <type_traits>
+#include <limits>
 using std::cout, std::endl;
 
 
 const bool DEBUG = false;
 const int INVALID = -1;
+typedef uint16_t RgfSym; //The RGF is 1-indexed, so a full alphabet of 256 byte symbols needs 16 bit digits
 
 //Combinatorial function to count the ways to rank:
 // - Filling up a sequence of N length (e.g. N = 3)
 // - Using an alphabet of A symbols available (e.g. A = {A,B,C} = 3 )
 // - Using subset K of symbols (e.g. K = 2)
-void addSymbolSection(fmpz_t rank, int seqLen, int maxSym, int k) {
-	if (k < 0 || k > seqLen || k > maxSym) return;
-	
-	uint64_t combinations = comb(maxSym, k);
-	
-	fmpz_t factorialK;	
-	fmpz_init(factorialK);
-	fmpz_fac_ui(factorialK, k);	
-	
-	fmpz_t stir2;
-	fmpz_init(stir2);
-	arith_stirling_number_2(stir2, seqLen, k);
-
-	fmpz_t product;
-	fmpz_init(product);
-	fmpz_mul(product, factorialK, stir2);	
-	fmpz_addmul_ui(rank, product, combinations);
-	
-	fmpz_clear(factorialK);
-	fmpz_clear(stir2);
-	fmpz_clear(product);
+//The table is cumulative, so entry K holds the size of all the sections using 1..K symbols
+void gen_symbol_sections(int seqLen, int maxSym, fmpz_mat_t sectionsOut) {
+	fmpz_mat_init(sectionsOut, 1, maxSym+1);
+	
+	//All the Stirling numbers S2(seqLen, 0..maxSym) in one go
+	fmpz* stir2 = _fmpz_vec_init(maxSym+1);
+	arith_stirling_number_2_vec(stir2, seqLen, maxSym+1);
+	
+	//comb(maxSym, k) * k! is the falling factorial maxSym * (maxSym-1) * ... * (maxSym-k+1)
+	fmpz_t fallingFact;
+	fmpz_init(fallingFact);
+	fmpz_one(fallingFact);
+	for (int k = 1; k <= maxSym; k++) {
+		fmpz_mul_ui(fallingFact, fallingFact, maxSym-k+1);
+		fmpz_set(fmpz_mat_entry(sectionsOut, 0, k), fmpz_mat_entry(sectionsOut, 0, k-1));
+		fmpz_addmul(fmpz_mat_entry(sectionsOut, 0, k), fallingFact, stir2+k);
+	}
+	fmpz_clear(fallingFact);
+	_fmpz_vec_clear(stir2, maxSym+1);
 }
 
+//The last table generated on this thread.  Ranking and unranking the same block length, 
+//(e.g. the verify step of the K search), keep asking for the same one
+struct SymbolSectionCache {
+	int seqLen = INVALID;
+	int maxSym = INVALID;
+	fmpz_mat_t sections;
+	
+	SymbolSectionCache() { fmpz_mat_init(sections, 1, 1); }
+	~SymbolSectionCache() { fmpz_mat_clear(sections); }
+};
+thread_local SymbolSectionCache symbolSectionCache;
 
+fmpz_mat_struct* get_symbol_sections(int seqLen, int maxSym) {
+	SymbolSectionCache& cache = symbolSectionCache;
+	if (cache.seqLen != seqLen || cache.maxSym != maxSym) {
+		fmpz_mat_clear(cache.sections);
+		gen_symbol_sections(seqLen, maxSym, cache.sections);
+		cache.seqLen = seqLen;
+		cache.maxSym = maxSym;
+	}
+	return cache.sections;
+}
 
-void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut) {
-			
-		
-	
-	//Pre-process seq	
-	int seqLen = valSeq.size();
-		
-	std::vector<int> valToSym(maxSym); //Put val in get sym out
-	
-	for (int i = 0; i < maxSym; i++) {
-		valToSym[i] = INVALID;
+void addSymbolSections(fmpz_t rank, int seqLen, int maxSym, int symCount) {
+	//Skip over all the sections with fewer symbols
+	fmpz_mat_struct* sections = get_symbol_sections(seqLen, maxSym);
+	fmpz_add(rank, rank, fmpz_mat_entry(sections, 0, symCount-1));
+}
+
+int findSymbolSection(fmpz_t rank, int seqLen, int maxSym) {
+	//Binary search for the first cumulative section past the rank, 
+	//then remove the sections before it from the rank
+	fmpz_mat_struct* sections = get_symbol_sections(seqLen, maxSym);
+	int lo = 1;
+	int hi = maxSym;
+	while (lo < hi) {
+		int mid = (lo+hi)/2;
+		if (fmpz_cmp(fmpz_mat_entry(sections, 0, mid), rank) > 0) hi = mid;
+		else lo = mid+1;
 	}
+	fmpz_sub(rank, rank, fmpz_mat_entry(sections, 0, lo-1));
+	return lo;
+}
+
 
-	std::vector<uint8_t> rgfSeq(seqLen);
+
+template <typename Digit, typename Sym>
+int near_rgf_rank(std::vector<Sym>& valSeq, std::vector<int>& valToSym, fmpz_t stirRankOut) {
+	//Maps the vals to the RGF in Digit, ranks it, and returns the symbol count
+	int seqLen = valSeq.size();
+	std::vector<Digit> rgfSeq(seqLen);
 			
 	int symCount = INVALID;	 
 	for (int i = 0; i < seqLen; i++){
-		uint8_t val = valSeq[i];
-		uint8_t sym;
+		int val = valSeq[i];
+		int sym;
 		//Create map of seq -> vals
 		if (valToSym[val] == INVALID) { //First time this symbol has been seen		
 			symCount++;
@@ -63,7 +99,37 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 		
 		rgfSeq[i] = sym + 1; //RGF is 1-indexed			
 	}
-	symCount++; //So that it reflects the total properly 
+	symCount++; //So that it reflects the total properly
+	
+	if (DEBUG) {
+		cout << "RGF Seq: ";
+		printVector(rgfSeq);
+	}
+	rgf_rank(rgfSeq, symCount, stirRankOut);
+	return symCount;
+}
+
+template <typename Sym>
+void near_entropic_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut) {
+	if (near_native_rank(valSeq, maxSym, rankOut)) return; //Short blocks stay in native integers, (see native_rank)
+			
+		
+	
+	//Pre-process seq	
+	int seqLen = valSeq.size();
+		
+	std::vector<int> valToSym(maxSym); //Put val in get sym out
+	
+	for (int i = 0; i < maxSym; i++) {
+		valToSym[i] = INVALID;
+	}
+
+	//Byte digits unless it's a full alphabet of bytes, (the RGF is 1-indexed)
+	fmpz_t stirRank;
+	fmpz_init(stirRank);
+	int symCount;
+	if (maxSym <= std::numeric_limits<Sym>::max()) symCount = near_rgf_rank<Sym>(valSeq, valToSym, stirRank);
+	else symCount = near_rgf_rank<RgfSym>(valSeq, valToSym, stirRank);
 	
 	if (DEBUG) {
 		cout << "Ranking: ";		
@@ -71,8 +137,8 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 	}
 	
 	//Permutation of symbols -> vals
-	std::vector<uint8_t> vals;
-	std::vector<uint8_t> symPerm;	
+	std::vector<Sym> vals;
+	std::vector<Sym> symPerm;	
 	
 	for (int i = 0; i < maxSym; i++) { 
 		//Traverse vals in order
@@ -84,9 +150,6 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 	
 	if (DEBUG) {
 		cout << "Sym Count: " << symCount << endl;
-		cout << "RGF Seq: ";
-		printVector(rgfSeq);
-		
 		cout << "Vals: ";
 		printVector(vals);		
 	}
@@ -95,9 +158,7 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 	fmpz_zero(rankOut);	
 	
 	// 1. Add symbol sections
-	for (int i = 1; i < symCount; i++) {				
-		addSymbolSection(rankOut, seqLen, maxSym, i);		
-	}
+	addSymbolSections(rankOut, seqLen, maxSym, symCount);
 		
 	if (DEBUG) {
 		cout << "Rank after symbol section: " << endl;
@@ -106,14 +167,14 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 	}
 	
 	//Calculate section sizes	
-	uint64_t totalComb = comb(maxSym, symCount);
 	fmpz_t combSectionSize;
 	fmpz_init(combSectionSize);
 	fmpz_fac_ui(combSectionSize, symCount);
 	
 	fmpz_t stirSectionSize;
 	fmpz_init(stirSectionSize);
-	fmpz_mul_ui(stirSectionSize, combSectionSize, totalComb);
+	fmpz_bin_uiui(stirSectionSize, maxSym, symCount); //(Past 64 bits for the larger alphabets)
+	fmpz_mul(stirSectionSize, stirSectionSize, combSectionSize);
 	
 	if (DEBUG) {
 		cout << "Comb Section Size: " << endl;
@@ -124,10 +185,7 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 		cout << endl;
 	}
 	
-	//  2. Add Set Partition / Stirling2 rank 		
-	fmpz_t stirRank;
-	fmpz_init(stirRank);		
-	rgf_rank(rgfSeq, symCount, stirRank);
+	//  2. Add Set Partition / Stirling2 rank, (from above)
 	fmpz_addmul(rankOut, stirRank, stirSectionSize);
 	fmpz_clear(stirSectionSize);
 	
@@ -139,16 +197,22 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 	fmpz_clear(stirRank);
 	
 	//  3. Add the combination rank 
-	uint64_t combRank = comb_rank(vals);	
-	fmpz_addmul_ui(rankOut, combSectionSize, combRank);
+	fmpz_t combRank;
+	fmpz_init(combRank);
+	if (maxSym <= COMB_NATIVE_MAX) fmpz_set_ui(combRank, comb_rank(vals));
+	else comb_rank(vals, combRank);
+	fmpz_addmul(rankOut, combSectionSize, combRank);
 	if (DEBUG) {
-		cout << "Comb Rank: " << combRank << endl;		
+		cout << "Comb Rank: ";
+		fmpz_print(combRank);
+		cout << endl;
 		cout << "Comb Vals: ";
 		printVector(vals);
 		cout << "Comb Section Size: ";
 		fmpz_print(combSectionSize);
 		cout << endl;
 	}
+	fmpz_clear(combRank);
 	fmpz_clear(combSectionSize);
 	
 	//  4. Add the Sym Perm Rank (Myrvold)	
@@ -173,75 +237,28 @@ void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut
 	fmpz_clear(symRank);			
 }
 
-void near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut) {
-			
-	
-	//  1. Get symbol section
-	if (DEBUG) {
-		cout << "Unranking" << endl;
-		cout << "Rank: " << endl;
-		fmpz_print(rank);
-		cout << endl;
-	}
-	fmpz_t count;
-	fmpz_t prevCount;
-	
-	fmpz_init(count);
-	fmpz_init(prevCount);
-	
-	fmpz_zero(count);
-	fmpz_zero(prevCount);
-	int symCount = INVALID;
-	for (int i = 1; i <= maxSym; i++) {
-		addSymbolSection(count, seqLen, maxSym, i);		
-		if (fmpz_cmp(count, rank) > 0) {		
-			symCount = i;
-			fmpz_sub(rank, rank, prevCount);
-			break;
-		}
-		else fmpz_set(prevCount, count);
-	}
-	
-	if (DEBUG) {
-		cout << "Sym Count: " << symCount << endl;		
-	}
-	fmpz_clear(count);
-	fmpz_clear(prevCount);
-	
+template <typename Digit, typename Sym>
+bool near_unrank_digits(fmpz_t rank, int seqLen, int maxSym, int symCount, fmpz_t combSectionSize, fmpz_t stirSectionSize, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy) {
+	//Steps 2 - 4 of near_entropic_unrank, with the RGF in Digit
+	bool completed;
 	
-	//Calculate section sizes	
-	uint64_t totalComb = comb(maxSym, symCount);
-	fmpz_t combSectionSize;
-	fmpz_init(combSectionSize);
-	fmpz_fac_ui(combSectionSize, symCount);
-	
-	fmpz_t stirSectionSize;
-	fmpz_init(stirSectionSize);
-	fmpz_mul_ui(stirSectionSize, combSectionSize, totalComb);
-	
-
-	if (DEBUG) {
-		cout << "Comb Section Size: " << endl;
-		fmpz_print(combSectionSize);
-		cout << endl;
-		cout << "Stir Section Size: " << endl;
-		fmpz_print(stirSectionSize);
-		cout << endl;
-	}
-
 	// 2. Get the values from the combination rank of symbols
 	fmpz_t rankModStir;	
 	fmpz_init(rankModStir);	
 	fmpz_mod(rankModStir, rank, stirSectionSize);			
 	fmpz_tdiv_q(rankModStir, rankModStir, combSectionSize);	
-	uint64_t combRank = fmpz_get_ui(rankModStir);	
+	if (DEBUG) {
+		cout << "Comb Rank: ";
+		fmpz_print(rankModStir);
+		cout << endl;
+	}
+	std::vector<Digit> combVals(symCount);	
+	if (maxSym <= COMB_NATIVE_MAX) comb_unrank(fmpz_get_ui(rankModStir), maxSym, symCount, combVals);
+	else comb_unrank(rankModStir, maxSym, symCount, combVals);
 	fmpz_clear(rankModStir);	
-	std::vector<uint8_t> combVals(symCount);	
-	comb_unrank(combRank, maxSym, symCount, combVals);
 	
 	
 	if (DEBUG) {
-		cout << "Comb Rank: " << combRank << endl;
 		cout << "Comb Vals: ";
 		printVector(combVals);
 	}
@@ -250,7 +267,7 @@ void near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>&
 	fmpz_t symRank;
 	fmpz_init(symRank);
 	fmpz_mod(symRank, rank, combSectionSize);	
-	std::vector<uint8_t> symPerm(symCount);
+	std::vector<Digit> symPerm(symCount);
 	if (DEBUG) {	
 		cout << "Sym Rank: ";
 		fmpz_print (symRank);
@@ -258,8 +275,7 @@ void near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>&
 	}
 	myrvold_unrank(symRank, symPerm);
 	fmpz_clear(symRank);
-	fmpz_clear(combSectionSize);
-	std::vector<uint8_t> invPerm(symCount);
+	std::vector<Digit> invPerm(symCount);
 	for (int i = 0; i < symCount; i++) {
 		invPerm[symPerm[i]] = i;
 	}
@@ -274,14 +290,72 @@ void near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>&
 	fmpz_t stirRank;
 	fmpz_init(stirRank);
 	fmpz_tdiv_q(stirRank, rank, stirSectionSize);
-	fmpz_clear(stirSectionSize);
 	if (DEBUG) {
 		cout << "Stir Rank: " << endl;
 		fmpz_print(stirRank);
 		cout << endl;					
 	}	
-	rgf_unrank_opt(stirRank, seqLen, symCount, combVals, invPerm, countsOut, rgfOut);		
+	if constexpr (std::is_same<Sym, Digit>::value) {
+		completed = rgf_unrank_opt(stirRank, seqLen, symCount, combVals, invPerm, countsOut, rgfOut, maxEntropy);		
+	}
+	else { //The digits are unranked wide, and then narrowed back to the vals
+		std::vector<Digit> rgfWide(seqLen);
+		completed = rgf_unrank_opt(stirRank, seqLen, symCount, combVals, invPerm, countsOut, rgfWide, maxEntropy);		
+		if (completed) rgfOut.assign(rgfWide.begin(), rgfWide.end());
+	}
 	fmpz_clear(stirRank);
+	return completed;
+}
+
+template <typename Sym>
+bool near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy) {
+	bool completed;
+	if (near_native_unrank(rank, seqLen, maxSym, countsOut, rgfOut, maxEntropy, completed)) return completed;
+			
+	
+	//  1. Get symbol section
+	if (DEBUG) {
+		cout << "Unranking" << endl;
+		cout << "Rank: " << endl;
+		fmpz_print(rank);
+		cout << endl;
+	}
+	int symCount = findSymbolSection(rank, seqLen, maxSym);
+	
+	if (DEBUG) {
+		cout << "Sym Count: " << symCount << endl;		
+	}
+	
+	
+	//Calculate section sizes	
+	fmpz_t combSectionSize;
+	fmpz_init(combSectionSize);
+	fmpz_fac_ui(combSectionSize, symCount);
+	
+	fmpz_t stirSectionSize;
+	fmpz_init(stirSectionSize);
+	fmpz_bin_uiui(stirSectionSize, maxSym, symCount); //(Past 64 bits for the larger alphabets)
+	fmpz_mul(stirSectionSize, stirSectionSize, combSectionSize);
+	
+
+	if (DEBUG) {
+		cout << "Comb Section Size: " << endl;
+		fmpz_print(combSectionSize);
+		cout << endl;
+		cout << "Stir Section Size: " << endl;
+		fmpz_print(stirSectionSize);
+		cout << endl;
+	}
+
+	//Byte digits unless it's a full alphabet of bytes, (the RGF is 1-indexed)
+	if (maxSym <= std::numeric_limits<Sym>::max()) completed = near_unrank_digits<Sym>(rank, seqLen, maxSym, symCount, combSectionSize, stirSectionSize, countsOut, rgfOut, maxEntropy);
+	else completed = near_unrank_digits<RgfSym>(rank, seqLen, maxSym, symCount, combSectionSize, stirSectionSize, countsOut, rgfOut, maxEntropy);
+	fmpz_clear(combSectionSize);
+	fmpz_clear(stirSectionSize);
+	if (!completed) {
+		if (DEBUG) cout << "Abandoned - entropy bound exceeded" << endl;
+		return false;
+	}
 	if (DEBUG) {
 		cout << "RGF Seq: ";
 		printVector(rgfOut);	
@@ -294,7 +368,10 @@ void near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>&
 		cout << "Final Seq: ";
 		printVector(rgfOut);
 	}
+	return true;
 }
 
-
-
+template void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut);
+template void near_entropic_rank(std::vector<uint16_t>& valSeq, int maxSym, fmpz_t rankOut);
+template bool near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut, double maxEntropy);
+template bool near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint16_t>& rgfOut, double maxEntropy);
@@ -10,8 +10,15 @@
 #include "combinations.h"
 #include "permutations.h"
 #include "rgf.h"
+#include "native_rank.h"
 
 
 
-void near_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut);
-void near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut);
\ No newline at end of file
+void gen_symbol_sections(int seqLen, int maxSym, fmpz_mat_t sectionsOut); //Cumulative section sizes by symbol count
+
+//Templated on the symbol type, (instantiated for uint8_t and uint16_t in near_entropic.cpp).
+//Raw bytes can go straight in with maxSym = 256, (the RGF is 1-indexed, so up to 65535 symbols)
+template <typename Sym>
+void near_entropic_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut);
+template <typename Sym>
+bool near_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy = NO_ENTROPY_BOUND);
\ No newline at end of file
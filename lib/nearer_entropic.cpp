@@ -4,9 +4,11 @@ using std::cout, std::endl;
 
 const bool DEBUG = false;
 const int INVALID = -1;
+const int NEARER_PARALLEL_MIN_LEN = 512; //Below this the part counts are cheaper than handing them out to the pool
 
-//Combinatorial function to count the ways to rank by symbol count - defined in near_entropic.cpp
-void addSymbolSection(fmpz_t rank, int seqLen, int maxSym, int k);
+//Combinatorial functions to rank by symbol count - defined in near_entropic.cpp
+void addSymbolSections(fmpz_t rank, int seqLen, int maxSym, int symCount);
+int findSymbolSection(fmpz_t rank, int seqLen, int maxSym);
 
 /*
 #ABOUT:  This is a function to rank a sequence in sorted entropic order, rather than the regular place-value base system.
@@ -25,7 +27,48 @@ void addSymbolSection(fmpz_t rank, int seqLen, int maxSym, int k);
 #  5. By the combination rank of the symbols used from the set of total available symbols
 #  6. By the permutation rank of the mapping the symbols to the set partition
 */
-void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut) {
+void nearer_rank_part(NearerPart& part, fmpz_mat_t kFacts, fmpq_mat_t coeffs) {
+	//The three sections of one part of the set partition, (2, 3, and 4 below)
+	int n = part.n;
+	int k = part.k;
+	int m = part.m;
+	int r = part.r;
+	fmpz_t nFact;
+	fmpz_t initialPartSectionSize;
+	fmpz_t elementSectionSize;
+	fmpz_init(nFact);		
+	fmpz_init(initialPartSectionSize);		
+	fmpz_init(elementSectionSize);		
+	
+	// 2. By Set Partition largest part section	
+	fmpz_fac_ui(nFact, n);
+	fmpz* kFact = fmpz_mat_entry(kFacts, 0, k);
+	stirling2_max_between(n, k, part.prevM, m, nFact, kFact, coeffs, part.largestPartRank);			
+	//Note: At this point in the unranking we have just found the value of m (largest part size)
+	
+	// 3. By Set Partition initial part size section
+	fmpz_fac_ui(nFact, n-1); 
+	kFact = fmpz_mat_entry(kFacts, 0, k-1);
+	stirling2_max_initial_gt(n, k, m, r, nFact, kFact, coeffs, part.initialPartRank);				
+
+	//Note: At this point in the unranking we know the length of the initial part of the set partition r
+	stirling2_max_initial_ge(n, k, m, r, nFact, kFact, coeffs, initialPartSectionSize);
+	fmpz_sub(initialPartSectionSize, initialPartSectionSize, part.initialPartRank);
+	
+	// 4. By Set Partition initial element combination 		
+	if (r > 1) { 
+		fmpz_bin_uiui(elementSectionSize, n-1, r-1); //The first element is always fixed as the lowest		
+		fmpz_tdiv_q(elementSectionSize, initialPartSectionSize, elementSectionSize);
+		comb_rank(part.elementIds, part.elementRank);	
+		fmpz_mul(part.elementRank, part.elementRank, elementSectionSize);
+	}
+	fmpz_clear(nFact);
+	fmpz_clear(initialPartSectionSize);
+	fmpz_clear(elementSectionSize);
+}
+
+template <typename Sym>
+void nearer_entropic_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut) {
 
 	//Pre-process seq	
 	int seqLen = valSeq.size();
@@ -35,29 +78,30 @@ void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankO
 		valToSym[i] = INVALID;
 	}
 
-	std::vector<std::set<int>> setPart;	
-	indexed_set_t unusedElements;
+	std::vector<int> seqSyms(seqLen);	
+	IndexedBits unusedElements;
+	indexed_bits_init(seqLen, unusedElements);
 	
 	int symCount = INVALID;	 
 	for (int i = 0; i < seqLen; i++){
-		uint8_t val = valSeq[i];
-		uint8_t sym;
+		int val = valSeq[i];
+		int sym;
 		//Create map of seq -> vals
 		if (valToSym[val] == INVALID) { //First time this symbol has been seen		
 			symCount++;
 			valToSym[val] = symCount;
 			sym = symCount;	
-			std::set<int> part = {i};
-			setPart.push_back(part);
 		}
 		else {
 			sym = valToSym[val];
-			setPart[sym].insert(setPart[sym].end(), i);
 		}
-		unusedElements.insert(i);
+		seqSyms[i] = sym;
 	}
 	symCount++; //So that it reflects the total properly 
 	
+	FlatSetPart setPart;
+	gen_flat_set_part(seqSyms, symCount, setPart);
+	
 	//Pre-calc
 	fmpz_mat_t kFacts;
 	gen_k_facts(symCount, kFacts);
@@ -71,8 +115,8 @@ void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankO
 	}
 	
 	//Permutation of symbols -> vals
-	std::vector<uint8_t> vals;
-	std::vector<uint8_t> symPerm;	
+	std::vector<Sym> vals;
+	std::vector<Sym> symPerm;	
 	
 	for (int i = 0; i < maxSym; i++) { 
 		//Traverse vals in order
@@ -92,9 +136,7 @@ void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankO
 	fmpz_zero(rankOut);	
 	
 	// 1. Add symbol sections
-	for (int i = 1; i < symCount; i++) {				
-		addSymbolSection(rankOut, seqLen, maxSym, i);		
-	}
+	addSymbolSections(rankOut, seqLen, maxSym, symCount);
 		
 	if (DEBUG) {
 		cout << "Rank after symbol section: ";
@@ -109,133 +151,86 @@ void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankO
 	//However, the extra complexity is required to achieve a better entropic order, as RGF order is not entropic
 	int n = seqLen; 
 	fmpz_t stirRank;
-	fmpz_t count;
-	fmpz_t initialPartSectionSize;
-	fmpz_t elementSectionSize;
-	fmpz_t elementRank;
-	fmpz_t nFact;
-	
 	fmpz_init(stirRank);		
-	fmpz_init(count);		
-	fmpz_init(initialPartSectionSize);		
-	fmpz_init(elementSectionSize);		
-	fmpz_init(elementRank);		
-	fmpz_init(nFact);		
-	
 	fmpz_zero(stirRank);
-		
-	int prevLargestPartSize = (n-symCount) + 1;	
 	
+	//Everything a part needs is known up front, so one cheap pass works out the part parameters, 
+	//(including the element ids, which depend on the elements the earlier parts used up),
+	//and then the counts for each part are independent, and can be done in parallel
+	std::vector<NearerPart> parts(std::max(symCount-1, 0));
+	int prevLargestPartSize = (n-symCount) + 1;	
 	
 	//Loop minus-1, because there is only a single way to do the last part that uses all the remaining elements
 	for (int p = 0; p < symCount-1; p++) { 	
-		fmpz_fac_ui(nFact, n);
-		int k = symCount - p;
-		int m = get_size_of_largest_part(setPart, p);
-		int r = setPart[p].size();
-		if (DEBUG) {
-			cout << "---- SET PART ITERATION: " << p << " ---" << endl;
-			cout << "K: " << k << endl;
-			cout << "M: " << m << endl;
-			cout << "R: " << r << endl;
-		}
-		
-		// 2. By Set Partition largest part section	
-		if (DEBUG) {
-			cout << "Stir Rank before Largest part section: ";
-			fmpz_print(stirRank);
-			cout << endl;
-		}
-		fmpz* kFact = fmpz_mat_entry(kFacts, 0, k);
-		stirling2_max_between(n, k, prevLargestPartSize, m, nFact, kFact, coeffs, count);			
-		fmpz_add(stirRank, stirRank, count);
-		prevLargestPartSize = m;	
-		if (DEBUG) {
-			cout << "Stir Rank after Largest part section: ";
-			fmpz_print(stirRank);
-			cout << endl;
-		}		
-		//Note: At this point in the unranking we have just found the value of m (largest part size)
-		
-		// 3. By Set Partition initial part size section
-		fmpz_fac_ui(nFact, n-1); 
-		kFact = fmpz_mat_entry(kFacts, 0, k-1);
-		stirling2_max_initial_gt(n, k, m, r, nFact, kFact, coeffs, count);				
-		fmpz_add(stirRank, stirRank, count);			
-	
-		//Note: At this point in the unranking we know the length of the initial part of the set partition r
-		stirling2_max_initial_ge(n, k, m, r, nFact, kFact, coeffs, initialPartSectionSize);
-		fmpz_sub(initialPartSectionSize, initialPartSectionSize, count);
-		
+		NearerPart& part = parts[p];
+		part.n = n;
+		part.k = symCount - p;
+		part.m = get_size_of_largest_part(setPart, p);
+		part.r = set_part_size(setPart, p);
+		part.prevM = prevLargestPartSize;
+		prevLargestPartSize = part.m;	
 		
 		// 4. By Set Partition initial element combination 		
-		unusedElements.erase(unusedElements.begin());		
-		if (r > 1) { //If r == 1, then it only has a single element, and there's only one way
+		indexed_bits_erase(unusedElements, indexed_bits_select(unusedElements, 0));		
+		if (part.r > 1) { //If r == 1, then it only has a single element, and there's only one way
 			//WARNING: This is a particularly tricky bit where we need to use an indexed position
 			//of our set of elements, and then remove the elements, which changes all the upstream
 			//index positions. (But, only AFTER they've all been used)
-			//NOTE:  To solve this, we are using the __gnu_pbds extention which implements
-			//an indexed ordered set: https://www.geeksforgeeks.org/cpp/ordered-set-gnu-c-pbds/			
+			//NOTE:  To solve this, we are using an indexed bit set, (see IndexedBits in base_lib)
 			//TODO: Perhaps this could be optimized by using Factoradics instead?
-			fmpz_bin_uiui(elementSectionSize, n-1, r-1); //The first element is always fixed as the lowest		
-			fmpz_tdiv_q(elementSectionSize, initialPartSectionSize, elementSectionSize);
-			
-			
-			std::vector<int> elementIds(r-1);
-			int e = 0;			
-			std::set<int>::iterator it = setPart[p].begin();						
-			for (it++; it != setPart[p].end(); it++) { //Ignore first element					
-				int elementVal = *it;
-				int elementId = unusedElements.order_of_key(elementVal);
-				elementIds[e] = elementId;
-				if (DEBUG) {
-					cout << "elementVal: " << +elementVal << endl;
-					cout << "elementId: " << +elementId << endl;
-					cout << "elementIds: " << elementIds[e] << endl;
-				}
-				e++;
+			const int* elements = set_part_elements(setPart, p);
+			std::vector<int> elementVals(elements+1, elements+part.r); //Ignore first element
+			part.elementIds.resize(part.r-1);
+			for (int e = 0; e < part.r-1; e++) {
+				part.elementIds[e] = indexed_bits_rank(unusedElements, elementVals[e]);
 			}	
-						
 			
 			//Remove all the used elements from the set
-			it = setPart[p].begin();
-			for (it++; it != setPart[p].end(); it++) { //Ignore first element			
-				int elementVal = *it;
-				unusedElements.erase(unusedElements.find(elementVal));							
-			}
-			
-			comb_rank(elementIds, elementRank);	
-			fmpz_mul(elementRank, elementRank, elementSectionSize);
-			fmpz_add(stirRank, stirRank, elementRank);	
-			if (DEBUG) {
-				cout << "Element Ids: ";
-				printVector(elementIds);				
-				cout << endl << endl;
-				cout << "Element Rank: ";
-				fmpz_print(elementRank);
-				cout << endl;
-				cout << "Stir Rank after elements: ";
-				fmpz_print(stirRank);
-				cout << endl;
-			}						
+			indexed_bits_erase_all(unusedElements, elementVals);
 		}
 		//Iterate - essentially we are recursing on all the rest of the parts
-		n -= r;
+		n -= part.r;
+	}
+	
+	auto rankPart = [&](int p) {
+		nearer_rank_part(parts[p], kFacts, coeffs);
+	};
+	if (seqLen >= NEARER_PARALLEL_MIN_LEN) thread_pool_run(get_thread_pool(), parts.size(), rankPart);
+	else for (int p = 0; p < (int)parts.size(); p++) rankPart(p);
+	
+	for (int p = 0; p < (int)parts.size(); p++) { 	
+		NearerPart& part = parts[p];
+		if (DEBUG) {
+			cout << "---- SET PART ITERATION: " << p << " ---" << endl;
+			cout << "K: " << part.k << endl;
+			cout << "M: " << part.m << endl;
+			cout << "R: " << part.r << endl;
+			cout << "Largest part section: ";
+			fmpz_print(part.largestPartRank);
+			cout << endl;
+			cout << "Initial part section: ";
+			fmpz_print(part.initialPartRank);
+			cout << endl;
+			cout << "Element Ids: ";
+			printVector(part.elementIds);				
+			cout << endl << endl;
+			cout << "Element Rank: ";
+			fmpz_print(part.elementRank);
+			cout << endl;
+		}
+		fmpz_add(stirRank, stirRank, part.largestPartRank);
+		fmpz_add(stirRank, stirRank, part.initialPartRank);
+		fmpz_add(stirRank, stirRank, part.elementRank);
 	}
-	fmpz_clear(count);
-	fmpz_clear(initialPartSectionSize);
-	fmpz_clear(elementSectionSize);
-	fmpz_clear(elementRank);
-	fmpz_clear(nFact);
 	
 	//Calculate section sizes	
 	fmpz_t stirSectionSize;
 	fmpz_init(stirSectionSize);
-	uint64_t totalComb = comb(maxSym, symCount);
 	fmpz_t combSectionSize;
 	fmpz_init(combSectionSize);
 	fmpz_fac_ui(combSectionSize, symCount);
-	fmpz_mul_ui(stirSectionSize, combSectionSize, totalComb);
+	fmpz_bin_uiui(stirSectionSize, maxSym, symCount); //(Past 64 bits for the larger alphabets)
+	fmpz_mul(stirSectionSize, stirSectionSize, combSectionSize);
 	
 	if (DEBUG) {
 		cout << "Comb Section Size: ";
@@ -258,16 +253,22 @@ void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankO
 	
 	
 	//  5. Add the combination rank 
-	uint64_t combRank = comb_rank(vals);	
-	fmpz_addmul_ui(rankOut, combSectionSize, combRank);
+	fmpz_t combRank;
+	fmpz_init(combRank);
+	if (maxSym <= COMB_NATIVE_MAX) fmpz_set_ui(combRank, comb_rank(vals));
+	else comb_rank(vals, combRank);
+	fmpz_addmul(rankOut, combSectionSize, combRank);
 	if (DEBUG) {
-		cout << "Comb Rank: " << combRank << endl;		
+		cout << "Comb Rank: ";
+		fmpz_print(combRank);
+		cout << endl;
 		cout << "Comb Vals: ";
 		printVector(vals);
 		cout << "Comb Section Size: ";
 		fmpz_print(combSectionSize);
 		cout << endl << endl;
 	}
+	fmpz_clear(combRank);
 	fmpz_clear(combSectionSize);
 	
 	//  6. Add the Sym Perm Rank (Myrvold)	
@@ -294,7 +295,8 @@ void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankO
 	fmpq_mat_clear(coeffs);
 }
 
-void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint8_t>& valSeqOut) {	
+template <typename Sym>
+bool nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy) {	
 	
 	//  1. Get symbol section
 	if (DEBUG) {
@@ -304,25 +306,7 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 		cout << endl;
 	}
 	
-	fmpz_t count;
-	fmpz_t prevCount;
-	
-	fmpz_init(count);
-	fmpz_init(prevCount);
-	
-	fmpz_zero(count);
-	fmpz_zero(prevCount);
-	int symCount = INVALID;
-	for (int i = 1; i <= maxSym; i++) {
-		addSymbolSection(count, seqLen, maxSym, i);		
-		if (fmpz_cmp(count, rank) > 0) {		
-			symCount = i;
-			fmpz_sub(rank, rank, prevCount);
-			break;
-		}
-		else fmpz_set(prevCount, count);
-	}
-	fmpz_clear(prevCount);
+	int symCount = findSymbolSection(rank, seqLen, maxSym);
 	if (DEBUG) {
 		cout << "Sym Count: " << symCount << endl;		
 	}	
@@ -335,14 +319,14 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 	
 	
 	//Calculate section sizes	
-	uint64_t totalComb = comb(maxSym, symCount);
 	fmpz_t combSectionSize;
 	fmpz_init(combSectionSize);
 	fmpz_fac_ui(combSectionSize, symCount);
 	
 	fmpz_t stirSectionSize;
 	fmpz_init(stirSectionSize);
-	fmpz_mul_ui(stirSectionSize, combSectionSize, totalComb);
+	fmpz_bin_uiui(stirSectionSize, maxSym, symCount); //(Past 64 bits for the larger alphabets)
+	fmpz_mul(stirSectionSize, stirSectionSize, combSectionSize);
 	
 
 	if (DEBUG) {
@@ -359,14 +343,18 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 	fmpz_init(rankModStir);	
 	fmpz_mod(rankModStir, rank, stirSectionSize);			
 	fmpz_tdiv_q(rankModStir, rankModStir, combSectionSize);	
-	uint64_t combRank = fmpz_get_ui(rankModStir);	
+	if (DEBUG) {
+		cout << "Comb Rank: ";
+		fmpz_print(rankModStir);
+		cout << endl;
+	}
+	std::vector<Sym> combVals(symCount);	
+	if (maxSym <= COMB_NATIVE_MAX) comb_unrank(fmpz_get_ui(rankModStir), maxSym, symCount, combVals);
+	else comb_unrank(rankModStir, maxSym, symCount, combVals);
 	fmpz_clear(rankModStir);	
-	std::vector<uint8_t> combVals(symCount);	
-	comb_unrank(combRank, maxSym, symCount, combVals);
 	
 	
 	if (DEBUG) {
-		cout << "Comb Rank: " << combRank << endl;
 		cout << "Comb Vals: ";
 		printVector(combVals);		
 	}
@@ -375,7 +363,7 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 	fmpz_t symRank;
 	fmpz_init(symRank);
 	fmpz_mod(symRank, rank, combSectionSize);	
-	std::vector<uint8_t> symPerm(symCount);
+	std::vector<Sym> symPerm(symCount);
 	if (DEBUG) {	
 		cout << "Sym Rank: ";
 		fmpz_print (symRank);
@@ -384,7 +372,7 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 	myrvold_unrank(symRank, symPerm);
 	fmpz_clear(symRank);
 	fmpz_clear(combSectionSize);
-	std::vector<uint8_t> invPerm(symCount);
+	std::vector<Sym> invPerm(symCount);
 	for (int i = 0; i < symCount; i++) {
 		invPerm[symPerm[i]] = i;
 	}
@@ -409,16 +397,27 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 	// Unrank the Set-Partition one part at a time
 	int n = seqLen;
 	int prevLargestPartSize = (n-symCount)+1;
-	indexed_set_t unusedElements;
-	for (int i = 0; i < n; i++) {
-		unusedElements.insert(i);
-	}	
+	
+	//Early abandonment - the entropy is xLogX[seqLen] - sum(xLogX[partSize]), and every
+	//part after this one is between 1 and m elements, which bounds how low the entropy can still go
+	bool bounded = maxEntropy < NO_ENTROPY_BOUND;
+	bool abandoned = false;
+	std::vector<double> xLogX;
+	double partSum = 0.0;
+	if (bounded) gen_xlogx(seqLen, xLogX);
+	
+	IndexedBits unusedElements;
+	indexed_bits_init(n, unusedElements);
+	fmpz_t count;
+	fmpz_t prevCount;
 	fmpz_t hiCount;
 	fmpz_t initialPartSectionSize;
 	fmpz_t elementSectionSize;
 	fmpz_t elementRank;
 	fmpz_t nFact;
 	
+	fmpz_init(count);	
+	fmpz_init(prevCount);	
 	fmpz_init(hiCount);	
 	fmpz_init(initialPartSectionSize);	
 	fmpz_init(elementSectionSize);	
@@ -431,7 +430,7 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 		if (DEBUG) {
 			cout << "---- SET PART ITERATION: " << p << " ---" << endl;
 		}
-		uint8_t partVal = combVals[invPerm[p]];		
+		Sym partVal = combVals[invPerm[p]];		
 				
 		//Set Partition largest part section
 		//Optimization - use Binary search to find "m"		
@@ -441,9 +440,12 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 		int lo = 1;
 		int bisections = ceil(log2(prevLargestPartSize));
 		fmpz* kFact = fmpz_mat_entry(kFacts, 0, k);
+		//The count below prevLargestPartSize is the same on every step, so only the count below mid is made in the loop, (see stirling2_max_between)
+		if (bisections > 0) stirling2_max_lt(n, k, prevLargestPartSize, nFact, kFact, coeffs, prevCount);
 		for (int i = 0; i < bisections; i++) {
 			int mid = floor((lo+hi)/2);
-			stirling2_max_between(n, k, prevLargestPartSize, mid, nFact, kFact, coeffs, count);
+			stirling2_max_lt(n, k, mid, nFact, kFact, coeffs, count);
+			fmpz_sub(count, prevCount, count);
 			if (fmpz_cmp(count, stirRank) > 0) {
 				lo = mid;
 			}
@@ -513,36 +515,55 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 		std::vector<int> elementIds(r-1);	
 		std::vector<int> elementVals(r-1);	
 		comb_unrank(elementRank, n-1, r-1, elementIds);
-		int initialElement = *unusedElements.begin();
-		unusedElements.erase(unusedElements.begin());		
+		int initialElement = indexed_bits_select(unusedElements, 0);
+		indexed_bits_erase(unusedElements, initialElement);		
 		valSeqOut[initialElement] = partVal;		
 		if (r > 1) {		
 			
 			for (size_t i = 0; i < elementIds.size(); i++) {
 				int elementId = elementIds[i];
-				int elementVal = *unusedElements.find_by_order(elementId);
+				int elementVal = indexed_bits_select(unusedElements, elementId);
 				elementVals[i] = elementVal;				
 				//Apply values here so we don't have to do another loop over the sequence				
 				valSeqOut[elementVal] = partVal;	
 			}
-			//Todo store iterators from previous? std::vector<indexed_set_t::iterator> its
-			for (size_t i = 0; i < elementVals.size(); i++) {
-				int elementVal = elementVals[i];				
-				unusedElements.erase(elementVal);
-			}
+			indexed_bits_erase_all(unusedElements, elementVals);
 			
 		}			
 		fmpz_sub(stirRank, stirRank, elementSectionSize);
 
 		n -= r; //Iterate		
+		
+		if (bounded) {
+			//By convexity the remaining parts have the least entropy when as many as possible are the full m elements
+			partSum += xLogX[r];
+			int remParts = symCount-1 - p;
+			double bestSum = partSum;
+			if (m > 1) {
+				int extra = n - remParts; //Elements beyond the one each remaining part needs
+				int fullParts = std::min(remParts, extra / (m-1));
+				bestSum += fullParts * xLogX[m];
+				if (fullParts < remParts) bestSum += xLogX[1 + extra - fullParts*(m-1)];
+			}
+			if (xLogX[seqLen] - bestSum > maxEntropy + ENTROPY_EPS) {
+				if (DEBUG) cout << "Abandoned - entropy bound exceeded" << endl;
+				abandoned = true;
+				break;
+			}
+		}
 	}
-	//Use all remaining elements for the last set
-	countsOut[maxSym-1] = unusedElements.size();
-	int finalPartVal = combVals[invPerm[symCount-1]];
-	for (int element: unusedElements) {		
-		valSeqOut[element] = finalPartVal;
+	if (!abandoned) {
+		//Use all remaining elements for the last set
+		countsOut[maxSym-1] = unusedElements.size;
+		int finalPartVal = combVals[invPerm[symCount-1]];
+		std::vector<int> finalElements;
+		indexed_bits_list(unusedElements, finalElements);
+		for (int element: finalElements) {		
+			valSeqOut[element] = finalPartVal;
+		}
 	}
 	fmpz_clear(count);
+	fmpz_clear(prevCount);
 	fmpz_clear(hiCount);
 	fmpz_clear(initialPartSectionSize);
 	fmpz_clear(elementSectionSize);
@@ -551,7 +572,10 @@ void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int
 	fmpz_clear(nFact);
 	fmpz_mat_clear(kFacts);
 	fmpq_mat_clear(coeffs);
+	return !abandoned;
 }
 
-
-
+template void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut);
+template void nearer_entropic_rank(std::vector<uint16_t>& valSeq, int maxSym, fmpz_t rankOut);
+template bool nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint8_t>& valSeqOut, double maxEntropy);
+template bool nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint16_t>& valSeqOut, double maxEntropy);
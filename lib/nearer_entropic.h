@@ -3,8 +3,7 @@
 #include <cstdint>
 #include <vector>
 #include <set>
-#include <ext/pb_ds/assoc_container.hpp> //Indexed set
-#include <ext/pb_ds/tree_policy.hpp> //Indexed set
+#include <algorithm>
 
 #include "flint/fmpz.h"
 #include "flint/arith.h"
@@ -13,9 +12,39 @@
 #include "combinations.h"
 #include "permutations.h"
 #include "set_partitions.h"
+#include "thread_pool.h"
 
-using namespace __gnu_pbds; //Indexed Set
-#define indexed_set_t tree<int, null_type,std::less<int>, rb_tree_tag,tree_order_statistics_node_update>
+struct NearerPart {
+	//One part of the set partition, and its share of the rank
+	int n; //Elements left, (including this part)
+	int k; //Parts left
+	int m; //Largest part size from here on
+	int r; //Size of this part
+	int prevM; //Largest part size from the previous part on
+	std::vector<int> elementIds; //Ids of the elements after the first, among the elements left
+	fmpz_t largestPartRank;
+	fmpz_t initialPartRank;
+	fmpz_t elementRank;
+	
+	NearerPart() { 
+		fmpz_init(largestPartRank); 
+		fmpz_init(initialPartRank); 
+		fmpz_init(elementRank); 
+	}
+	~NearerPart() { 
+		fmpz_clear(largestPartRank); 
+		fmpz_clear(initialPartRank); 
+		fmpz_clear(elementRank); 
+	}
+	NearerPart(const NearerPart&) = delete;
+	NearerPart& operator=(const NearerPart&) = delete;
+};
 
-void nearer_entropic_rank(std::vector<uint8_t>& valSeq, int maxSym, fmpz_t rankOut);
-void nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<uint8_t>& valSeqOut);
\ No newline at end of file
+void nearer_rank_part(NearerPart& part, fmpz_mat_t kFacts, fmpq_mat_t coeffs);
+
+//Templated on the symbol type, (instantiated for uint8_t and uint16_t in nearer_entropic.cpp).
+//Raw bytes can go straight in with maxSym = 256
+template <typename Sym>
+void nearer_entropic_rank(std::vector<Sym>& valSeq, int maxSym, fmpz_t rankOut);
+template <typename Sym>
+bool nearer_entropic_unrank(fmpz_t rank, int seqLen, int maxSym, std::vector<int>& countsOut, std::vector<Sym>& valSeqOut, double maxEntropy = NO_ENTROPY_BOUND);
\ No newline at end of file
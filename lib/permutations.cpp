@@ -1,13 +1,14 @@
 #include "permutations.h"
 #include <iostream>
 
-void myrvold_rank_recur(int n, std::vector<uint8_t>& perm, std::vector<uint8_t>& invPerm, fmpz_t rankOut) {
+template <typename Sym>
+void myrvold_rank_recur(int n, std::vector<Sym>& perm, std::vector<Sym>& invPerm, fmpz_t rankOut) {
 	if (n < 2) return; //Anchor
 	
-	uint8_t s = perm[n-1];
+	Sym s = perm[n-1];
 	//Swap
-	uint8_t tmp1 = perm[invPerm[n-1]];
-	uint8_t tmp2 = perm[n-1];
+	Sym tmp1 = perm[invPerm[n-1]];
+	Sym tmp2 = perm[n-1];
 	perm[n-1] = tmp1;
 	perm[invPerm[n-1]] = tmp2;
 	
@@ -25,19 +26,25 @@ void myrvold_rank_recur(int n, std::vector<uint8_t>& perm, std::vector<uint8_t>&
 
 
 
-void myrvold_rank(std::vector<uint8_t> perm, fmpz_t rankOut) {
+template <typename Sym>
+void myrvold_rank(std::vector<Sym> perm, fmpz_t rankOut) {
 	fmpz_zero(rankOut);
 	int permSize = perm.size();
-	std::vector<uint8_t> invPerm(perm.size());
+	if (permSize <= SMALL_SYM_MAX) {
+		fmpz_set_ui(rankOut, myrvold_rank_ui(perm));
+		return;
+	}
+	std::vector<Sym> invPerm(perm.size());
 	for (int i = 0; i < permSize; i++) {
-		uint8_t pos = perm[i];
+		Sym pos = perm[i];
 		invPerm[pos] = i;
 	}
 	
 	myrvold_rank_recur(permSize, perm, invPerm, rankOut);
 }
 
-void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<uint8_t>& permOut) {
+template <typename Sym>
+void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<Sym>& permOut) {
 	if (n < 1) return; //Anchor
 		
 		
@@ -50,8 +57,8 @@ void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<uint8_t>& permOut) {
 	fmpz_tdiv_q_ui(rank, rank, n);
 	
 	//Swap
-	uint8_t tmp1 = permOut[n-1];
-	uint8_t tmp2 = permOut[r];
+	Sym tmp1 = permOut[n-1];
+	Sym tmp2 = permOut[r];
 	permOut[r] = tmp1;
 	permOut[n-1] = tmp2;
 	
@@ -59,12 +66,81 @@ void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<uint8_t>& permOut) {
 	
 }
 
-void myrvold_unrank(fmpz_t rank, std::vector<uint8_t>& permOut) {	
+template <typename Sym>
+void myrvold_unrank(fmpz_t rank, std::vector<Sym>& permOut) {	
 	//Start with identity so that unranking can shuffle into place		
 	int permSize = permOut.size();
+	if (permSize <= SMALL_SYM_MAX) {
+		myrvold_unrank_ui(fmpz_get_ui(rank), permOut);
+		fmpz_zero(rank); //(As the recursion leaves it)
+		return;
+	}
 	for (int i = 0; i < permSize; i++) {
 		permOut[i] = i;		
 	}
 		
 	myrvold_unrank_recur(rank, permSize, permOut); //Perm is mutated in the recursive function	
-}
\ No newline at end of file
+}
+
+template <typename Sym>
+uint64_t myrvold_rank_ui(std::vector<Sym>& perm) {
+	return myrvold_rank_ui(perm.data(), perm.size());
+}
+
+template <typename Sym>
+uint64_t myrvold_rank_ui(const Sym* perm, int permSize) {
+	//Same as myrvold_rank, but unrolled, (the swaps go top down, and the digits fold back up from the bottom).
+	//Note: this works on a copy, since the swaps mutate the perm
+	Sym p[SMALL_SYM_MAX];
+	Sym invPerm[SMALL_SYM_MAX];
+	uint8_t digits[SMALL_SYM_MAX];
+	for (int i = 0; i < permSize; i++) {
+		p[i] = perm[i];
+		invPerm[perm[i]] = i;
+	}
+	for (int n = permSize; n >= 2; n--) {
+		Sym s = p[n-1];
+		digits[n-1] = s;
+		Sym pos = invPerm[n-1];
+		p[pos] = s;
+		p[n-1] = n-1;
+		invPerm[s] = pos;
+		invPerm[n-1] = n-1;
+	}
+	uint64_t rank = 0;
+	for (int n = 2; n <= permSize; n++) {
+		rank = rank * n + digits[n-1];
+	}
+	return rank;
+}
+
+template <typename Sym>
+void myrvold_unrank_ui(uint64_t rank, std::vector<Sym>& permOut) {
+	myrvold_unrank_ui(rank, permOut.data(), permOut.size());
+}
+
+template <typename Sym>
+void myrvold_unrank_ui(uint64_t rank, Sym* permOut, int permSize) {
+	for (int i = 0; i < permSize; i++) {
+		permOut[i] = i;		
+	}
+	for (int n = permSize; n >= 1; n--) {
+		int r = rank % n;
+		rank /= n;
+		Sym tmp = permOut[n-1];
+		permOut[n-1] = permOut[r];
+		permOut[r] = tmp;
+	}
+}
+
+#define PERM_INSTANTIATE(Sym) \
+	template void myrvold_rank_recur(int n, std::vector<Sym>& perm, std::vector<Sym>& invPerm, fmpz_t rankOut); \
+	template void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<Sym>& permOut); \
+	template void myrvold_rank(std::vector<Sym> perm, fmpz_t rankOut); \
+	template void myrvold_unrank(fmpz_t rank, std::vector<Sym>& permOut); \
+	template uint64_t myrvold_rank_ui(std::vector<Sym>& perm); \
+	template void myrvold_unrank_ui(uint64_t rank, std::vector<Sym>& permOut); \
+	template uint64_t myrvold_rank_ui(const Sym* perm, int permSize); \
+	template void myrvold_unrank_ui(uint64_t rank, Sym* permOut, int permSize);
+PERM_INSTANTIATE(uint8_t)
+PERM_INSTANTIATE(uint16_t)
\ No newline at end of file
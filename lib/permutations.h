@@ -2,10 +2,37 @@
 #include <vector>
 #include <cstdint>
 #include "flint/fmpz.h"
+#include "combinations.h"
 
-void myrvold_rank_recur(int n, std::vector<uint8_t>& perm, std::vector<uint8_t>& invPerm, fmpz_t rankOut);
-void myrvold_rank(std::vector<uint8_t> perm, fmpz_t rankOut);
+struct FactTable {
+	uint64_t f[SMALL_SYM_MAX+1];
+};
 
-void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<uint8_t>& permOut);
-void myrvold_unrank(fmpz_t rank, std::vector<uint8_t>& permOut);
+constexpr FactTable gen_fact_table() {
+	FactTable table = {};
+	table.f[0] = 1;
+	for (int n = 1; n <= SMALL_SYM_MAX; n++) table.f[n] = table.f[n-1] * n;
+	return table;
+}
+constexpr FactTable FACTS = gen_fact_table();
 
+//The permutation functions are templated on the symbol type, (instantiated for uint8_t and uint16_t in permutations.cpp)
+
+template <typename Sym>
+void myrvold_rank_recur(int n, std::vector<Sym>& perm, std::vector<Sym>& invPerm, fmpz_t rankOut);
+template <typename Sym>
+void myrvold_rank(std::vector<Sym> perm, fmpz_t rankOut);
+
+template <typename Sym>
+void myrvold_unrank_recur(fmpz_t rank, int n, std::vector<Sym>& permOut);
+template <typename Sym>
+void myrvold_unrank(fmpz_t rank, std::vector<Sym>& permOut);
+
+template <typename Sym>
+uint64_t myrvold_rank_ui(std::vector<Sym>& perm); //Native, (up to SMALL_SYM_MAX)
+template <typename Sym>
+void myrvold_unrank_ui(uint64_t rank, std::vector<Sym>& permOut); //Native, (up to SMALL_SYM_MAX)
+template <typename Sym>
+uint64_t myrvold_rank_ui(const Sym* perm, int permSize);
+template <typename Sym>
+void myrvold_unrank_ui(uint64_t rank, Sym* permOut, int permSize);
@@ -1,5 +1,69 @@
 #include "rgf.h"
+#include "io_lib.h"
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+
+const bool DEBUG = false;
+const int INVALID = -1;
+
+//Divide-and-conquer ranking/unranking
+const int RGF_DC_THRESHOLD = 1024; //Sequences still not saturated after this many positions are finished in halves, (if k <= RGF_DC_MAX_K)
+const int RGF_DC_MAX_K = 20; //Power basis weights are kept in a ulong, which needs (k-1) * (k-1)! < 2^64
+const int RGF_DC_CUTOFF = 512; //Below this many positions the stepwise unrank is quicker
+const int RGF_DC_GUARD = 64; //Extra bits kept when the rank is truncated to find a first half
+const int RGF_DC_MAX_ADJUST = 64; //Correcting a first half should only take a step or two - otherwise fall back to stepwise
+std::atomic<int> rgfDcGuard{RGF_DC_GUARD};
+
+void set_rgf_dc_guard(int bits) {
+	rgfDcGuard.store(bits, std::memory_order_relaxed);
+}
+int get_rgf_dc_guard() {
+	return rgfDcGuard.load(std::memory_order_relaxed);
+}
+
+struct RgfEntropyBound {
+	//Tracks a lower bound on the entropy of an RGF as its digits become final, (in order).
+	//Entropy is xLogX[n] - sum(xLogX[count]).  Convexity means the sum is largest (and entropy smallest) 
+	//when all the free remaining positions go to the biggest count, which gives a lower bound at each step
+	int n;
+	int k;
+	double maxEntropy;
+	std::vector<double> xLogX;
+	std::vector<int> counts;
+	double countSum = 0.0;
+	int maxCount = 1;
+	int currentMax = 1;
+	int done = 1; //The RGF always starts with 1
+	bool abandoned = false;
+	
+	RgfEntropyBound(int n, int k, double maxEntropy) : n(n), k(k), maxEntropy(maxEntropy), counts(k+2) {
+		if (maxEntropy < NO_ENTROPY_BOUND) gen_xlogx(n, xLogX);
+		counts[1] = 1;
+	}
+	
+	template <typename Sym>
+	bool add(const Sym* digits, int len) {
+		//Returns false once the finished sequence can no longer have less entropy than maxEntropy
+		for (int i = 0; i < len; i++) {
+			int digit = digits[i];
+			int count = ++counts[digit];
+			countSum += xLogX[count] - xLogX[count-1];
+			if (count > maxCount) maxCount = count;
+			if (digit > currentMax) currentMax = digit;
+		}
+		done += len;
+		
+		int remLen = n - done;
+		int unopened = k - currentMax; //Each unopened block still needs at least one position
+		double bestSum = countSum - xLogX[maxCount] + xLogX[maxCount + remLen - unopened];
+		if (xLogX[n] - bestSum > maxEntropy + ENTROPY_EPS) abandoned = true;
+		return !abandoned;
+	}
+};
+
+template <typename Sym>
+void rgf_unrank_dc_rest(fmpz_t rank, int start, int n, int currentMax, int k, std::vector<Sym>& rgfOut, RgfEntropyBound* bound);
 
 void gen_rgf_table(int n, int k, fmpz_mat_t tableOut) {
 	//Generates a table where table[remLen][currentMax] stores the number of ways 
@@ -13,6 +77,8 @@ void gen_rgf_table(int n, int k, fmpz_mat_t tableOut) {
 	// we have already reached exactly k blocks	
 	fmpz_one(fmpz_mat_entry(tableOut, 0, k));
 	
+	fmpz_t product;
+	fmpz_init(product);
 	for (int length = 1; length < (n+1); length++) {
 		for (int m = 1; m < (k+1); m++) {
 			// Recurrence:
@@ -23,7 +89,6 @@ void gen_rgf_table(int n, int k, fmpz_mat_t tableOut) {
 			// Note: If m+1 > k, table[length-1][m+1] will be 0, enforcing the limit.
 			
 			//table[length][m] = (m * table[length-1][m]) + table[length-1][m+1]	
-			fmpz_t product;
 			fmpz_mul_ui(product, fmpz_mat_entry(tableOut, length-1, m), m);
 			fmpz_add(
 				fmpz_mat_entry(tableOut, length, m),
@@ -32,6 +97,7 @@ void gen_rgf_table(int n, int k, fmpz_mat_t tableOut) {
 			);
 		}
 	}
+	fmpz_clear(product);
 	
 	//fmpz_mat_print_pretty(tableOut);
 	//Don't forget to call fmpz_mat_clear(table);
@@ -45,10 +111,11 @@ void gen_rgf_row_old(int n, int k, uint8_t& CUR, fmpz_mat_t rowOut) { //Deprecat
 	
 	uint8_t NEXT = !CUR;
 	
+	fmpz_t product;
+	fmpz_init(product);
 	for (int length = 1; length < (n+1); length++) {				
 		for (int m = 1; m < (k+1); m++) {
 			// Standard Recurrence: S(L, m) = m*S(L-1, m) + S(L-1, m+1)
-			fmpz_t product;
 			fmpz_mul_ui(product, fmpz_mat_entry(rowOut, CUR, m), m);
 			fmpz_add(
 				fmpz_mat_entry(rowOut, NEXT, m),
@@ -61,19 +128,91 @@ void gen_rgf_row_old(int n, int k, uint8_t& CUR, fmpz_mat_t rowOut) { //Deprecat
 		NEXT ^= CUR;
 		CUR ^= NEXT;
 	}	
+	fmpz_clear(product);
 }
 
 void gen_rgf_row(int n, int k, fmpz_mat_t rowOut) {
 	//Note: This calculates an arbitrary starting row, which is signicantly quicker
 	//than calculating from the beginning
 	fmpz_mat_init(rowOut, 2, k+2); //Two rows to swap to optimize memory allocation	
-			
+	
+	//Every cell sums the same powers, so they are only calculated once
+	fmpz_mat_t powers;
+	gen_rgf_powers(n, k, powers);
 	for (int m = 1; m < (k+1); m++) {
 		int level = m-1;
-		gen_rgf_cell(n, k, level, rowOut);	
+		gen_rgf_cell_powers(k, level, powers, rowOut);	
+	}
+	fmpz_mat_clear(powers);
+}
+
+void load_rgf_table(const char* dir, int n, int k, fmpz_mat_t tableOut) {
+	//Same as gen_rgf_table, but kept in the table store under dir, (generated and stored the first time)
+	if (load_rgf_stored(dir, n, k, TABLE_ENGINE_RGF_TABLE, tableOut)) return;
+	gen_rgf_table(n, k, tableOut);
+	table_store_write(table_store_path(dir, n, k, TABLE_ENGINE_RGF_TABLE).c_str(), tableOut, n, k, TABLE_ENGINE_RGF_TABLE);
+}
+
+void load_rgf_row(const char* dir, int n, int k, fmpz_mat_t rowOut) {
+	//Same as gen_rgf_row, but kept in the table store under dir, (generated and stored the first time)
+	if (load_rgf_stored(dir, n, k, TABLE_ENGINE_RGF_ROW, rowOut)) return;
+	gen_rgf_row(n, k, rowOut);
+	table_store_write(table_store_path(dir, n, k, TABLE_ENGINE_RGF_ROW).c_str(), rowOut, n, k, TABLE_ENGINE_RGF_ROW);
+}
+
+bool load_rgf_stored(const char* dir, int n, int k, int engine, fmpz_mat_t matOut) {
+	//Every entry is copied out, which touches every page anyway, so the checksum is checked too.
+	//A corrupt or truncated table is turned down, and the callers generate it again over the top
+	TableStore store;
+	if (!table_store_open(table_store_path(dir, n, k, engine).c_str(), store, true)) return false;
+	const TableStoreHeader* header = store.header;
+	bool found = header->n == n && header->k == k && (int)header->engine == engine;
+	if (found) table_store_get_mat(store, matOut);
+	table_store_close(store);
+	return found;
+}
+
+void gen_rgf_powers(int n, int k, fmpz_mat_t powersOut) {
+	//Generates powersOut[b] = b^n for b in [0, k].
+	//Only primes need an actual power - composites are the product of two smaller powers, (and 2^n is a shift)
+	fmpz_mat_init(powersOut, 1, k+1);
+	if (n == 0) fmpz_one(fmpz_mat_entry(powersOut, 0, 0));
+	if (k < 1) return;
+	fmpz_one(fmpz_mat_entry(powersOut, 0, 1));
+	
+	for (int b = 2; b < (k+1); b++) {
+		int factor = 2;
+		while (b % factor != 0) factor++; //Smallest prime factor
+		
+		fmpz* power = fmpz_mat_entry(powersOut, 0, b);
+		if (factor < b) fmpz_mul(power, fmpz_mat_entry(powersOut, 0, factor), fmpz_mat_entry(powersOut, 0, b / factor));
+		else if (b == 2) fmpz_mul_2exp(power, fmpz_mat_entry(powersOut, 0, 1), n);
+		else fmpz_ui_pow_ui(power, b, n);
 	}
 }
 
+void gen_rgf_cell_powers(int k, int level, fmpz_mat_t powers, fmpz_mat_t rowOut) {
+	//Same as gen_rgf_cell, but with the powers from gen_rgf_powers
+	int col = k-level;
+	uint8_t CUR = 0;
+	fmpz* cell = fmpz_mat_entry(rowOut, CUR, col);
+	fmpz_zero(cell);
+	if (level >= k) return;
+	
+	fmpz_t pascalWeight; //Treating Pascal Triangle like a lookup table of weights
+	fmpz_init(pascalWeight);
+	for (int i = 0; i < level+1; i++) {
+		fmpz_bin_uiui(pascalWeight, level, i);
+		if (i % 2 != 0) fmpz_submul(cell, pascalWeight, fmpz_mat_entry(powers, 0, k-i));
+		else fmpz_addmul(cell, pascalWeight, fmpz_mat_entry(powers, 0, k-i));
+	}
+	
+	//Always divides evenly
+	fmpz_fac_ui(pascalWeight, level);	
+	fmpz_divexact(cell, cell, pascalWeight);
+	fmpz_clear(pascalWeight);
+}
+
 void gen_rgf_cell(int n, int k, int level, fmpz_mat_t rowOut) {
 	//Calculate arbitrary cell of RGF table
 	//Note: This can be used to calculate a starting row significantly
@@ -118,7 +257,16 @@ void gen_rgf_cell(int n, int k, int level, fmpz_mat_t rowOut) {
 }
 
 
-void rgf_rank(std::vector<uint8_t>& rgf, int k, fmpz_t rankOut) {
+template <typename Sym>
+void rgf_rank(std::vector<Sym>& rgf, int k, fmpz_t rankOut) {
+	if (k <= RGF_DC_MAX_K) {
+		//The row ranking is quick once all k blocks are open, (see rgf_rank_tail), so only late saturation needs D&C
+		int saturated = std::find(rgf.begin(), rgf.end(), k) - rgf.begin();
+		if (saturated > RGF_DC_THRESHOLD) {
+			rgf_rank_dc(rgf, k, rankOut);
+			return;
+		}
+	}
 		
 	// Get the starting row:
     // At index i=1, the remaining length is (n-2).
@@ -130,7 +278,8 @@ void rgf_rank(std::vector<uint8_t>& rgf, int k, fmpz_t rankOut) {
 }
 
 
-void rgf_rank_table(std::vector<uint8_t>& rgf, int k, fmpz_mat_t table, fmpz_t rankOut) {
+template <typename Sym>
+void rgf_rank_table(std::vector<Sym>& rgf, int k, fmpz_mat_t table, fmpz_t rankOut) {
 	// This calculates the rank of a set-partition with exactly k-parts
 	int n = rgf.size();
 	int currentMax = 1;
@@ -140,7 +289,7 @@ void rgf_rank_table(std::vector<uint8_t>& rgf, int k, fmpz_mat_t table, fmpz_t r
 	// RGF always starts with 1, so we iterate from the second element
 	for (int i = 1; i < n; i++) {
 		int remLen = n - 1 - i;
-		uint8_t digit = rgf[i];
+		int digit = rgf[i];
 		
 		// We count the "branches" of the decision tree we skipped
 		// Branches are ordered 1, 2, ..., currentMax, currentMax+1
@@ -166,81 +315,105 @@ void rgf_rank_table(std::vector<uint8_t>& rgf, int k, fmpz_mat_t table, fmpz_t r
 }
 
 
-void rgf_rank_row(std::vector<uint8_t>& rgf, int k, fmpz_mat_t row, fmpz_t rankOut) {
+template <typename Sym>
+void rgf_rank_row(std::vector<Sym>& rgf, int k, fmpz_mat_t row, fmpz_t rankOut) {
 	//Ranks an RGF forward (index 1 -> n) using only O(k) space
     //by mathematically inverting the Stirling recurrence at each step.
 	//NOTE: row is actually two rows - current and previous and we swap 
-	//between them for more efficient memory usage
+	//between them for more efficient memory usage, (see RgfRow)
 	int n = rgf.size();
 	fmpz_zero(rankOut);
 	if (n <= 1) return;
 	
-	
-	uint8_t CUR = 0;
-	uint8_t PREV = 1;
+	RgfRow limbRow;
+	rgf_row_init(limbRow, row, k);
     
+	mpz_t bigRank; //Kept as an mpz so it can work directly with the row's limbs
+	mpz_t view;
+	mpz_init(bigRank);
 	int currentMax = 1;
+	int tailStart = INVALID;
 	
 	for (int i = 1; i < n; i++) {
-		uint8_t digit = rgf[i];
+		if (currentMax == k) { //Saturated - the rest is just a base-k number
+			tailStart = i;
+			break;
+		}
+		int digit = rgf[i];
+		mpz_srcptr weight = rgf_row_entry(limbRow, currentMax, view);
 		
 		// Standard Forward Ranking Logic
         if (digit == currentMax + 1) {
             // We picked a new block. 
             // We skipped 'currentMax' branches that would have kept the max same.            
-			fmpz_addmul_ui(rankOut, fmpz_mat_entry(row, CUR, currentMax), currentMax);
+			mpz_addmul_ui(bigRank, weight, currentMax);
             currentMax++;
 		}
 		else {
 			// We picked an existing block.
             // We skipped (digit - 1) branches of smaller existing blocks.
-			fmpz_addmul_ui(rankOut, fmpz_mat_entry(row, CUR, currentMax), (digit - 1));
+			mpz_addmul_ui(bigRank, weight, (digit - 1));
 		}
 		
 		// Downgrade the table row for the next step (Length L -> L-1)
         // We only need to do this if there are steps remaining
 		if (i < n - 1) {
-			// Inverted Recurrence: S(L-1, m) = (S(L, m) - S(L-1, m+1)) / m
-            // We must iterate backwards (k -> 1) because we need prev_row[m+1]
-            for (int m = k; m >= currentMax; m--) {
-
-                // Always divides evenly
-				fmpz_sub(
-					fmpz_mat_entry(row, PREV, m),				
-					fmpz_mat_entry(row, CUR, m),				
-					fmpz_mat_entry(row, PREV, m+1)
-				);
-				fmpz_tdiv_q_ui(
-					fmpz_mat_entry(row, PREV, m), 
-					fmpz_mat_entry(row, PREV, m),
-					m
-				);  
-				//Note: The ranking can potentially be done in reverse,
-				//which allows the minor optimization of multiplication, instead of division.
-				//However, this is ONLY for ranking, as the unranking can not be done in reverse
-			}
-			
-			//Swap
-			CUR ^= PREV;
-			PREV ^= CUR;
-			CUR ^= PREV;			
+			rgf_row_downgrade(limbRow, currentMax);
+			//Note: The ranking can potentially be done in reverse,
+			//which allows the minor optimization of multiplication, instead of division.
+			//However, this is ONLY for ranking, as the unranking can not be done in reverse
 		}
 	}	
+	fmpz_set_mpz(rankOut, bigRank);
+	mpz_clear(bigRank);
+	if (tailStart != INVALID) rgf_rank_tail(rgf, tailStart, k, rankOut);
 }
 
-void rgf_unrank(fmpz_t rank, int n, int k, std::vector<uint8_t>& rgfOut) {		
+template <typename Sym>
+void rgf_rank_tail(std::vector<Sym>& rgf, int start, int k, fmpz_t rankOut) {
+	//Once all k blocks are open, the row entry for k is just k^remLen, 
+	//so the rest of the RGF, (as digit-1), is a base-k number, which b2n converts in bulk
+	int len = rgf.size() - start;
+	std::vector<Sym> digits(len);
+	for (int j = 0; j < len; j++) {
+		digits[len-1-j] = rgf[start+j] - 1; //b2n is little-endian
+	}
+	std::vector<int> counts(k);
+	fmpz_t tailRank;
+	fmpz_init(tailRank);
+	b2n(digits, k, counts, tailRank);
+	fmpz_add(rankOut, rankOut, tailRank);
+	fmpz_clear(tailRank);
+}
+
+template <typename Sym>
+void rgf_unrank_tail(fmpz_t rank, int start, int n, int k, std::vector<Sym>& rgfOut) {
+	//Inverse of rgf_rank_tail - fills rgfOut[start..n) from the rank left once all k blocks are open
+	int len = n - start;
+	std::vector<Sym> digits(len);
+	n2b(rank, k, digits);
+	for (int j = 0; j < len; j++) {
+		rgfOut[start+j] = digits[len-1-j] + 1;
+	}
+}
+
+template <typename Sym>
+void rgf_unrank(fmpz_t rank, int n, int k, std::vector<Sym>& rgfOut) {		
 	fmpz_mat_t row;	
 	gen_rgf_row(n-1, k, row);
 	rgf_unrank_row(rank, n, k, row, rgfOut);	
 	fmpz_mat_clear(row);
 }
-void rgf_unrank_opt(fmpz_t rank, int n, int k, std::vector<uint8_t>& combVals, std::vector<uint8_t>& invPerm, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut) {
+template <typename Sym>
+bool rgf_unrank_opt(fmpz_t rank, int n, int k, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy) {
 	fmpz_mat_t row;	
 	gen_rgf_row(n-1, k, row);
-	rgf_unrank_row_opt(rank, n, k, row, combVals, invPerm, countsOut, rgfOut);	
+	bool completed = rgf_unrank_row_opt(rank, n, k, row, combVals, invPerm, countsOut, rgfOut, maxEntropy);	
 	fmpz_mat_clear(row);
+	return completed;
 }
-void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<uint8_t>& rgfOut) {
+template <typename Sym>
+void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<Sym>& rgfOut) {
 	//Converts a rank back into an RGF of length n with exactly k parts	
 
 	rgfOut[0] = 1;
@@ -248,13 +421,14 @@ void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<u
 	
 	fmpz_t countStay;
 	fmpz_t tVal;
+	fmpz_t weightStay;
 	fmpz_init(countStay);
 	fmpz_init(tVal);
+	fmpz_init(weightStay);
 	for (int i = 1; i < n; i++) {
 		int remLen = n - 1 - i;
 		
 		// Calculate the "weight" (number of possibilities) if we join an existing block
-		fmpz_t weightStay;		
 		fmpz_set(weightStay, fmpz_mat_entry(table, remLen, currentMax));
 		
 		// Total possibilities covered by joining ANY existing block (1..currentMax)		
@@ -267,7 +441,6 @@ void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<u
 			fmpz_tdiv_q(tVal, rank, weightStay);
 			int val = fmpz_get_ui(tVal) + 1;
 			rgfOut[i] = val;
-			fmpz_clear(tVal);
 			fmpz_mod(rank, rank, weightStay);
 		}
 		else {
@@ -279,146 +452,587 @@ void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<u
 	}
 	fmpz_clear(tVal);
 	fmpz_clear(countStay);
-	
+	fmpz_clear(weightStay);
 }
 
-void rgf_unrank_row(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<uint8_t>& rgfOut) {
+template <typename Sym>
+void rgf_unrank_row(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<Sym>& rgfOut) {
 	//Unranks an RGF using O(K) space by inverting the Stirling recurrence on the fly.
 
 	rgfOut[0] = 1;
 	int currentMax = 1;
-	uint8_t CUR = 0;
-	uint8_t PREV = 1;
 	
-	fmpz_t countStay;
-	fmpz_t tVal;
-	fmpz_init(countStay);
-	fmpz_init(tVal);
+	RgfRow limbRow;
+	rgf_row_init(limbRow, row, k);
+	
+	mpz_t bigRank; //Kept as an mpz so it can work directly with the row's limbs
+	mpz_t countStay;
+	mpz_t tVal;
+	mpz_t view;
+	mpz_init(bigRank);
+	mpz_init(countStay);
+	mpz_init(tVal);
+	fmpz_get_mpz(bigRank, rank);
+	fmpz_zero(rank);
 	for (int i = 1; i < n; i++) {
 		//if (i % 10000 == 0) std::cout << "Unrank: " << i << std::endl;
-		
-		// Inverted Recurrence: S(L-1, m) = (S(L, m) - S(L-1, m+1)) / m
-		// We must iterate backwards (k -> 1) because we need prev_row[m+1]
-		for (int m = k; m >= currentMax; m--) {
-
-			// Always divides evenly
-			fmpz_sub(
-				fmpz_mat_entry(row, PREV, m),				
-				fmpz_mat_entry(row, CUR, m),				
-				fmpz_mat_entry(row, PREV, m+1)
-			);
-			fmpz_tdiv_q_ui(
-				fmpz_mat_entry(row, PREV, m), 
-				fmpz_mat_entry(row, PREV, m),
-				m
-			);                
+		if (currentMax == k) { //Saturated - the rest is just a base-k number
+			fmpz_set_mpz(rank, bigRank);
+			rgf_unrank_tail(rank, i, n, k, rgfOut);
+			break;
+		}
+		if (i == RGF_DC_THRESHOLD && k <= RGF_DC_MAX_K) { //Saturating late - finish in halves instead
+			fmpz_set_mpz(rank, bigRank);
+			rgf_unrank_dc_rest(rank, i, n, currentMax, k, rgfOut, NULL);
+			break;
 		}
 		
-		//Swap
-		CUR ^= PREV;
-		PREV ^= CUR;
-		CUR ^= PREV;
+		rgf_row_downgrade(limbRow, currentMax);
 
 		// Now current row corresponds to the correct 'rem_len' for this part
 		
 		// Calculate the "weight" (number of possibilities) if we join an existing block
-		fmpz_t weightStay;
-		fmpz_set(weightStay, fmpz_mat_entry(row, CUR, currentMax));
+		mpz_srcptr weightStay = rgf_row_entry(limbRow, currentMax, view);
+		mpz_mul_ui(countStay, weightStay, currentMax);
 		
-		fmpz_mul_ui(countStay, weightStay, currentMax);
-		
-		if (fmpz_cmp(rank, countStay) < 0) {	
+		if (mpz_cmp(bigRank, countStay) < 0) {	
 			// Stay with existing block
-			fmpz_tdiv_q(tVal, rank, weightStay);
-			int val = fmpz_get_ui(tVal) + 1;
-			rgfOut[i] = val;
-			fmpz_clear(tVal);
-			fmpz_mod(rank, rank, weightStay);
+			mpz_tdiv_qr(tVal, bigRank, bigRank, weightStay);
+			rgfOut[i] = mpz_get_ui(tVal) + 1;
 		}
 		else {
 			// Create new block
 			rgfOut[i] = currentMax + 1;
-			fmpz_sub(rank, rank, countStay);			
+			mpz_sub(bigRank, bigRank, countStay);			
 			currentMax++;
 		}		
 		
 	}
-	fmpz_clear(tVal);
-	fmpz_clear(countStay);	
+	mpz_clear(tVal);
+	mpz_clear(countStay);	
+	mpz_clear(bigRank);
 }
 
-void rgf_unrank_row_opt(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<uint8_t>& combVals, std::vector<uint8_t>& invPerm, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut) {
+template <typename Sym>
+bool rgf_unrank_row_opt(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy) {
 	//Unranks an RGF using O(K) space by inverting the Stirling recurrence on the fly.
+	//If maxEntropy is given, this returns false as soon as the finished sequence can no longer 
+	//have less entropy than it, leaving rgfOut and countsOut partially filled
 
-	rgfOut[0] = 1;
+	//First value special case - the RGF always starts with 1
+	rgfOut[0] = combVals[invPerm[0]];
+	countsOut[0]++;
 	int currentMax = 1;
-	uint8_t CUR = 0;
-	uint8_t PREV = 1;
 	
-	fmpz_t countStay;
-	fmpz_t tVal;
-	fmpz_init(countStay);
-	fmpz_init(tVal);
+	bool bounded = maxEntropy < NO_ENTROPY_BOUND;
+	RgfEntropyBound bound(n, k, maxEntropy);
+	
+	RgfRow limbRow;
+	rgf_row_init(limbRow, row, k);
+	
+	mpz_t bigRank; //Kept as an mpz so it can work directly with the row's limbs
+	mpz_t countStay;
+	mpz_t tVal;
+	mpz_t view;
+	mpz_init(bigRank);
+	mpz_init(countStay);
+	mpz_init(tVal);
+	fmpz_get_mpz(bigRank, rank);
+	fmpz_zero(rank);
+	bool completed = true;
 	for (int i = 1; i < n; i++) {
 		//if (i % 1000 == 0) std::cout << "Unrank: " << i << std::endl;
-		
-		// Inverted Recurrence: S(L-1, m) = (S(L, m) - S(L-1, m+1)) / m
-		// We must iterate backwards (k -> 1) because we need prev_row[m+1]
-		for (int m = k; m >= currentMax; m--) {
-
-			// Always divides evenly
-			fmpz_sub(
-				fmpz_mat_entry(row, PREV, m),				
-				fmpz_mat_entry(row, CUR, m),				
-				fmpz_mat_entry(row, PREV, m+1)
-			);
-			fmpz_tdiv_q_ui(
-				fmpz_mat_entry(row, PREV, m), 
-				fmpz_mat_entry(row, PREV, m),
-				m
-			);                
+		if (currentMax == k || (i == RGF_DC_THRESHOLD && k <= RGF_DC_MAX_K)) {
+			fmpz_set_mpz(rank, bigRank);
+			if (currentMax == k) { //Saturated - the rest is just a base-k number
+				rgf_unrank_tail(rank, i, n, k, rgfOut);
+				if (bounded) bound.add(&rgfOut[i], n-i);
+			}
+			else { //Saturating late - finish in halves instead
+				rgf_unrank_dc_rest(rank, i, n, currentMax, k, rgfOut, bounded? &bound : NULL);
+			}
+			if (bound.abandoned) {
+				completed = false;
+				break;
+			}
+			for (int j = i; j < n; j++) {
+				int sym = rgfOut[j]-1;
+				rgfOut[j] = combVals[invPerm[sym]];
+				countsOut[sym]++;
+			}
+			break;
 		}
 		
-		//Swap
-		CUR ^= PREV;
-		PREV ^= CUR;
-		CUR ^= PREV;
+		rgf_row_downgrade(limbRow, currentMax);
 
 		// Now current row corresponds to the correct 'rem_len' for this part
 		
 		// Calculate the "weight" (number of possibilities) if we join an existing block
-		fmpz_t weightStay;
-		fmpz_set(weightStay, fmpz_mat_entry(row, CUR, currentMax));
+		mpz_srcptr weightStay = rgf_row_entry(limbRow, currentMax, view);
+		mpz_mul_ui(countStay, weightStay, currentMax);
 		
-		fmpz_mul_ui(countStay, weightStay, currentMax);
-		
-		if (fmpz_cmp(rank, countStay) < 0) {	
+		if (mpz_cmp(bigRank, countStay) < 0) {	
 			// Stay with existing block
-			fmpz_tdiv_q(tVal, rank, weightStay);
-			int val = fmpz_get_ui(tVal) + 1;
-			rgfOut[i] = val;
-			fmpz_clear(tVal);
-			fmpz_mod(rank, rank, weightStay);
+			mpz_tdiv_qr(tVal, bigRank, bigRank, weightStay);
+			rgfOut[i] = mpz_get_ui(tVal) + 1;
 		}
 		else {
 			// Create new block
 			rgfOut[i] = currentMax + 1;
-			fmpz_sub(rank, rank, countStay);			
+			mpz_sub(bigRank, bigRank, countStay);			
 			currentMax++;
 		}		
 		
+		if (bounded && !bound.add(&rgfOut[i], 1)) {
+			completed = false;
+			break;
+		}
+		
 		//Optimization - apply values here so we don't have to do another loop over the sequence
-		uint8_t sym = rgfOut[i]-1;
-		uint8_t combVal = combVals[invPerm[sym]];
+		int sym = rgfOut[i]-1;
+		int combVal = combVals[invPerm[sym]];
 		rgfOut[i] = combVal;
 		countsOut[sym]++;
 	}
+	mpz_clear(tVal);
+	mpz_clear(countStay);	
+	mpz_clear(bigRank);
+	return completed;
+}
+
+//---- Limb-contiguous row ----
+void rgf_row_init(RgfRow& rowOut, fmpz_mat_t row, int k) {
+	//Copies the current row, (row 0), of a two-row fmpz_mat_t from gen_rgf_row 
+	rowOut.k = k;
+	rowOut.cur = 0;
+	rowOut.width = 1;
+	for (int m = 1; m < (k+1); m++) {
+		rowOut.width = std::max(rowOut.width, (slong)fmpz_size(fmpz_mat_entry(row, 0, m)));
+	}
+	rowOut.limbs.assign(2 * (k+2) * rowOut.width, 0);
+	rowOut.sizes.assign(2 * (k+2), 0);
+	
+	mpz_t entry;
+	mpz_init(entry);
+	for (int m = 1; m < (k+1); m++) {
+		fmpz_get_mpz(entry, fmpz_mat_entry(row, 0, m));
+		slong size = mpz_size(entry);
+		std::copy(mpz_limbs_read(entry), mpz_limbs_read(entry) + size, rgf_row_limbs(rowOut, 0, m));
+		rowOut.sizes[m] = size;
+	}
+	mpz_clear(entry);
+}
+
+mp_limb_t* rgf_row_limbs(RgfRow& row, int r, int col) {
+	return row.limbs.data() + ((slong)r * (row.k+2) + col) * row.width;
+}
+
+mpz_srcptr rgf_row_entry(RgfRow& row, int col, mpz_t view) {
+	//Read-only mpz view of an entry of the current row, (no copy)
+	return mpz_roinit_n(view, rgf_row_limbs(row, row.cur, col), row.sizes[row.cur * (row.k+2) + col]);
+}
+
+void rgf_row_downgrade(RgfRow& row, int currentMax) {
+	// Inverted Recurrence: S(L-1, m) = (S(L, m) - S(L-1, m+1)) / m
+	// We must iterate backwards (k -> 1) because we need prev_row[m+1]
+	int k = row.k;
+	uint8_t prev = !row.cur;
+	slong* curSizes = row.sizes.data() + row.cur * (k+2);
+	slong* prevSizes = row.sizes.data() + prev * (k+2);
+	for (int m = k; m >= currentMax; m--) {
+		prevSizes[m] = rgf_sub_divexact_ui(
+			rgf_row_limbs(row, prev, m),
+			rgf_row_limbs(row, row.cur, m), curSizes[m],
+			rgf_row_limbs(row, prev, m+1), prevSizes[m+1], //Column k+1 is always 0
+			m
+		);
+	}
+	row.cur = prev;
+}
+
+slong rgf_sub_divexact_ui(mp_limb_t* out, const mp_limb_t* a, slong aSize, const mp_limb_t* b, slong bSize, ulong m) {
+	//out = (a - b) / m in a single pass from the low limb up, where a >= b and m divides evenly.  Returns the size of out.
+	//Exact division runs low to high, (like the subtraction), by multiplying with the inverse of the odd part of m mod 2^64.
+	//The power of 2 in m is then shifted out one limb behind
+	int shift = __builtin_ctzl(m);
+	ulong odd = m >> shift;
+	ulong inverse = odd; //Correct to 3 bits for any odd number, and each step doubles that
+	for (int i = 0; i < 5; i++) inverse *= 2 - odd * inverse;
+	
+	mp_limb_t subBorrow = 0;
+	mp_limb_t divBorrow = 0;
+	mp_limb_t prevQ = 0;
+	for (slong i = 0; i < aSize; i++) {
+		mp_limb_t bLimb = i < bSize ? b[i] : 0;
+		mp_limb_t diff = a[i] - bLimb;
+		mp_limb_t borrow = a[i] < bLimb;
+		borrow |= diff < subBorrow;
+		diff -= subBorrow;
+		subBorrow = borrow;
+		
+		mp_limb_t low = diff - divBorrow;
+		divBorrow = diff < divBorrow;
+		mp_limb_t q = low * inverse;
+		divBorrow += (mp_limb_t)(((unsigned __int128)q * odd) >> FLINT_BITS);
+		
+		if (shift == 0) out[i] = q;
+		else {
+			if (i > 0) out[i-1] = (prevQ >> shift) | (q << (FLINT_BITS - shift));
+			prevQ = q;
+		}
+	}
+	if (shift > 0 && aSize > 0) out[aSize-1] = prevQ >> shift;
+	
+	slong size = aSize;
+	while (size > 0 && out[size-1] == 0) size--;
+	return size;
+}
+
+
+//---- Divide-and-conquer unranking ----
+//Each row of the table can be written in a "power basis" of i^remLen for i = 1..k, (see gen_rgf_cell).
+//That allows jumping straight to the row at the middle of a sequence, and ranking a whole prefix 
+//at once with radix conversions (b2n), so the sequence can be unranked in halves, instead of one step at a time.
+//Every row here is a plain fmpz vector of k+2 entries, (column 0 unused, and column k+1 always 0)
+
+void rgf_advance_row(fmpz* term, int len, int k, fmpz* rowOut) {
+	//Jumps 'len' positions back from a terminal row: rowOut[m] = the number of ways to fill 'len' positions
+	//starting from max m, where finishing on max m' counts with weight term[m'].
+	//(With term = 1 at k and 0 elsewhere, this is just gen_rgf_row)
+	//Power basis: rowOut[m] = sum(i^len * delta[i] / (i-m)!) for i in [m,k], 
+	//where delta[i] = sum((-1)^(m'-i) * term[m'] / (m'-i)!) for m' in [i,k].
+	//Everything is scaled by (k-1)! so the coefficients stay integers, and divided out exactly at the end
+	std::vector<ulong> facts(k);
+	facts[0] = 1;
+	for (int i = 1; i < k; i++) facts[i] = facts[i-1] * i;
+	ulong scale = facts[k-1];
+	
+	fmpz* delta = _fmpz_vec_init(k+2);
+	fmpz_mat_t powers;
+	gen_rgf_powers(len, k, powers);
+	for (int i = 1; i <= k; i++) {
+		for (int end = i; end <= k; end++) {
+			if ((end - i) % 2 == 0) fmpz_addmul_ui(delta+i, term+end, scale / facts[end-i]);
+			else fmpz_submul_ui(delta+i, term+end, scale / facts[end-i]);
+		}
+		fmpz_mul(delta+i, delta+i, fmpz_mat_entry(powers, 0, i));
+	}
+	fmpz_mat_clear(powers);
+	
+	fmpz_t scaleSq;
+	fmpz_init(scaleSq);
+	fmpz_set_ui(scaleSq, scale);
+	fmpz_mul_ui(scaleSq, scaleSq, scale);
+	fmpz_zero(rowOut);
+	fmpz_zero(rowOut+k+1);
+	for (int m = 1; m <= k; m++) {
+		fmpz_zero(rowOut+m);
+		for (int i = m; i <= k; i++) {
+			fmpz_addmul_ui(rowOut+m, delta+i, scale / facts[i-m]);
+		}
+		fmpz_divexact(rowOut+m, rowOut+m, scaleSq);
+	}
+	fmpz_clear(scaleSq);
+	_fmpz_vec_clear(delta, k+2);
+}
+
+template <typename Sym>
+void rgf_prefix_weights(const Sym* digits, int len, int m, int k, fmpz* weightsOut) {
+	//Ranks a whole prefix of 'len' digits, (starting from max m), at once.
+	//The rank skipped by the prefix is sum(weightsOut[m'] * endRow[m']), where endRow is the row after the prefix.
+	//Each position j skips (digit-1) branches of weight P(m_j, m'), the number of paths of the remaining 
+	//(len-1-j) positions in the prefix from its max m_j to m'.  In the power basis P is a sum of i^(len-1-j), 
+	//so for each i, the positions together are one number in base i - which b2n converts in quasi-linear time
+	std::vector<ulong> facts(k);
+	facts[0] = 1;
+	for (int i = 1; i < k; i++) facts[i] = facts[i-1] * i;
+	ulong scale = facts[k-1];
+	
+	std::vector<int> states(len); //The max before each position
+	int currentMax = m;
+	for (int j = 0; j < len; j++) {
+		states[j] = currentMax;
+		if (digits[j] > currentMax) currentMax = digits[j];
+	}
+	
+	fmpz* sums = _fmpz_vec_init(k+2);
+	std::vector<ulong> radixDigits(len);
+	for (int i = m; i <= k; i++) {
+		for (int j = 0; j < len; j++) {
+			//Note: These digits can be bigger than the base i
+			if (states[j] <= i) radixDigits[len-1-j] = (digits[j] - 1) * (scale / facts[i - states[j]]);
+			else radixDigits[len-1-j] = 0;
+		}
+		b2n_ui(radixDigits, i, sums+i);
+	}
+	
+	fmpz_t scaleSq;
+	fmpz_init(scaleSq);
+	fmpz_set_ui(scaleSq, scale);
+	fmpz_mul_ui(scaleSq, scaleSq, scale);
+	for (int end = 0; end <= k+1; end++) fmpz_zero(weightsOut+end);
+	for (int end = m; end <= k; end++) {
+		for (int i = m; i <= end; i++) {
+			if ((end - i) % 2 == 0) fmpz_addmul_ui(weightsOut+end, sums+i, scale / facts[end-i]);
+			else fmpz_submul_ui(weightsOut+end, sums+i, scale / facts[end-i]);
+		}
+		fmpz_divexact(weightsOut+end, weightsOut+end, scaleSq);
+	}
+	fmpz_clear(scaleSq);
+	_fmpz_vec_clear(sums, k+2);
+}
+
+template <typename Sym>
+int rgf_prefix_max(const Sym* digits, int len, int m) {
+	for (int j = 0; j < len; j++) {
+		if (digits[j] > m) m = digits[j];
+	}
+	return m;
+}
+
+template <typename Sym>
+bool rgf_prefix_next(Sym* digits, int len, int m, int k) {
+	//Steps to the lexicographically next prefix, (returns false if this is already the last one)
+	int last = INVALID;
+	for (int j = 0; j < len; j++) {
+		if (digits[j] < std::min(m+1, k)) last = j;
+		if (digits[j] > m) m = digits[j];
+	}
+	if (last == INVALID) return false;
+	digits[last]++;
+	for (int j = last+1; j < len; j++) digits[j] = 1;
+	return true;
+}
+
+template <typename Sym>
+bool rgf_prefix_prev(Sym* digits, int len, int m, int k) {
+	//Steps to the lexicographically previous prefix, (returns false if this is already the first one)
+	int last = INVALID;
+	for (int j = 0; j < len; j++) {
+		if (digits[j] > 1) last = j;
+	}
+	if (last == INVALID) return false;
+	digits[last]--;
+	m = rgf_prefix_max(digits, last+1, m);
+	for (int j = last+1; j < len; j++) {
+		digits[j] = std::min(m+1, k);
+		if (digits[j] > m) m = digits[j];
+	}
+	return true;
+}
+
+template <typename Sym>
+void rgf_unrank_steps(fmpz_t rank, int len, int m, int k, fmpz* term, Sym* digitsOut) {
+	//Same as rgf_unrank_row, but for 'len' positions starting from max m, and ending on the terminal row.
+	//Out of range ranks, (which only come from a truncated first half), are clamped to the nearest prefix
+	fmpz* cur = _fmpz_vec_init(k+2);
+	fmpz* prev = _fmpz_vec_init(k+2);
+	rgf_advance_row(term, len, k, cur);
+	
+	fmpz_t countStay;
+	fmpz_t tVal;
+	fmpz_init(countStay);
+	fmpz_init(tVal);
+	for (int i = 0; i < len; i++) {
+		// Inverted Recurrence: S(L-1, m) = (S(L, m) - S(L-1, m+1)) / m
+		for (int col = k; col >= m; col--) {
+			fmpz_sub(prev+col, cur+col, prev+col+1);
+			fmpz_divexact_ui(prev+col, prev+col, col);
+		}
+		std::swap(cur, prev);
+		
+		fmpz* weightStay = cur+m;
+		fmpz_mul_ui(countStay, weightStay, m);
+		if (m < k && fmpz_cmp(rank, countStay) >= 0) {
+			// Create new block
+			digitsOut[i] = m + 1;
+			fmpz_sub(rank, rank, countStay);
+			m++;
+		}
+		else if (fmpz_is_zero(weightStay)) {
+			digitsOut[i] = 1;
+		}
+		else {
+			// Stay with existing block
+			fmpz_fdiv_q(tVal, rank, weightStay);
+			ulong val = fmpz_cmp_ui(tVal, m-1) > 0 ? m-1 : fmpz_get_ui(tVal);
+			digitsOut[i] = val + 1;
+			fmpz_submul_ui(rank, weightStay, val);
+		}
+	}
 	fmpz_clear(tVal);
-	fmpz_clear(countStay);	
-	
-	//First value special case
-	uint8_t sym = rgfOut[0]-1;
-	uint8_t val = combVals[invPerm[sym]];
-	rgfOut[0] = val;
-	countsOut[sym]++;
-}
\ No newline at end of file
+	fmpz_clear(countStay);
+	_fmpz_vec_clear(prev, k+2);
+	_fmpz_vec_clear(cur, k+2);
+}
+
+template <typename Sym>
+bool rgf_adjust_prefix(fmpz_t rank, Sym* digits, int len, int m, int k, fmpz* midRow) {
+	//Moves a prefix found from a truncated rank until the rank left over fits in the rest of the sequence.
+	//Returns false if it is too far off, (which shouldn't happen with the guard bits)
+	for (int step = 0; step <= RGF_DC_MAX_ADJUST; step++) {
+		int endMax = rgf_prefix_max(digits, len, m);
+		if (fmpz_sgn(rank) < 0) {
+			if (!rgf_prefix_prev(digits, len, m, k)) {
+				fmpz_zero(rank);
+				return true;
+			}
+			fmpz_add(rank, rank, midRow + rgf_prefix_max(digits, len, m));
+		}
+		else if (fmpz_cmp(rank, midRow+endMax) >= 0) {
+			if (!rgf_prefix_next(digits, len, m, k)) {
+				fmpz_sub_ui(rank, midRow+endMax, 1);
+				if (fmpz_sgn(rank) < 0) fmpz_zero(rank);
+				return true;
+			}
+			fmpz_sub(rank, rank, midRow+endMax);
+		}
+		else return true;
+	}
+	return false;
+}
+
+template <typename Sym>
+void rgf_unrank_dc_recur(fmpz_t rank, int len, int m, int k, fmpz* term, Sym* digitsOut, RgfEntropyBound* bound) {
+	//Unranks 'len' positions starting from max m, where finishing on max m' counts with weight term[m'].
+	//The bound, (if any), only sees digits once they are final, so it is not passed to truncated first halves
+	if (m == k && fmpz_is_one(term+k)) { //Saturated, (and exact) - the rest is just a base-k number, (see rgf_unrank_tail)
+		std::vector<Sym> digits(len);
+		n2b(rank, k, digits);
+		for (int j = 0; j < len; j++) digitsOut[j] = digits[len-1-j] + 1;
+		if (bound) bound->add(digitsOut, len);
+		return;
+	}
+	if (len <= RGF_DC_CUTOFF) {
+		rgf_unrank_steps(rank, len, m, k, term, digitsOut);
+		if (bound) bound->add(digitsOut, len);
+		return;
+	}
+	int len2 = len / 2;
+	int len1 = len - len2;
+	
+	//The row at the split point is the terminal row for the first half
+	fmpz* midRow = _fmpz_vec_init(k+2);
+	rgf_advance_row(term, len2, k, midRow);
+	
+	//1. First half - only the top bits of the rank matter here, so everything can be shifted down,
+	//as long as the smallest entry still has room for every step of the first half plus some guard bits
+	int stepBits = 1;
+	while ((1 << stepBits) <= k) stepBits++;
+	slong minBits = WORD_MAX;
+	for (int col = m; col <= k; col++) {
+		if (!fmpz_is_zero(midRow+col)) minBits = std::min(minBits, (slong)fmpz_bits(midRow+col));
+	}
+	slong shift = minBits - ((slong)len1 * stepBits + get_rgf_dc_guard());
+	
+	fmpz_t firstRank;
+	fmpz_t origRank;
+	fmpz_init(firstRank);
+	fmpz_init(origRank);
+	fmpz_set(origRank, rank);
+	if (shift > 0) {
+		fmpz* shiftedRow = _fmpz_vec_init(k+2);
+		for (int col = m; col <= k; col++) fmpz_fdiv_q_2exp(shiftedRow+col, midRow+col, shift);
+		fmpz_fdiv_q_2exp(firstRank, rank, shift);
+		rgf_unrank_dc_recur(firstRank, len1, m, k, shiftedRow, digitsOut, NULL);
+		_fmpz_vec_clear(shiftedRow, k+2);
+	}
+	else {
+		fmpz_set(firstRank, rank);
+		rgf_unrank_dc_recur(firstRank, len1, m, k, midRow, digitsOut, bound);
+	}
+	
+	//2. Subtract the exact rank of the first half, and correct it if the truncation left it slightly off
+	if (!bound || !bound->abandoned) {
+		fmpz* weights = _fmpz_vec_init(k+2);
+		rgf_prefix_weights(digitsOut, len1, m, k, weights);
+		for (int col = m; col <= k; col++) fmpz_submul(rank, weights+col, midRow+col);
+		_fmpz_vec_clear(weights, k+2);
+		
+		if (!rgf_adjust_prefix(rank, digitsOut, len1, m, k, midRow)) {
+			if (DEBUG) std::cout << "RGF D&C: falling back to stepwise unrank for " << len << std::endl;
+			rgf_unrank_steps(origRank, len, m, k, term, digitsOut);
+			if (bound) bound->add(digitsOut, len);
+			fmpz_zero(rank);
+		}
+		else {
+			if (bound && shift > 0) bound->add(digitsOut, len1);
+			
+			//3. Second half, with the exact remaining rank
+			if (!bound || !bound->abandoned) {
+				int midMax = rgf_prefix_max(digitsOut, len1, m);
+				rgf_unrank_dc_recur(rank, len2, midMax, k, term, digitsOut+len1, bound);
+			}
+		}
+	}
+	fmpz_clear(origRank);
+	fmpz_clear(firstRank);
+	_fmpz_vec_clear(midRow, k+2);
+}
+
+template <typename Sym>
+void rgf_unrank_dc_rest(fmpz_t rank, int start, int n, int currentMax, int k, std::vector<Sym>& rgfOut, RgfEntropyBound* bound) {
+	//Unranks rgfOut[start..n) in halves, given the max so far
+	if (start >= n) return;
+	fmpz* term = _fmpz_vec_init(k+2);
+	fmpz_one(term+k); //Length 0 is valid only if max is already k
+	rgf_unrank_dc_recur(rank, n-start, currentMax, k, term, rgfOut.data()+start, bound);
+	_fmpz_vec_clear(term, k+2);
+}
+
+template <typename Sym>
+void rgf_rank_dc(std::vector<Sym>& rgf, int k, fmpz_t rankOut) {
+	//Quasi-linear ranking, (for k <= RGF_DC_MAX_K) - the whole sequence is one prefix ending on the terminal row, 
+	//(which is 1 at k), so the rank is its weight at k.  The per-position contributions are combined 
+	//by the b2n power trees, which is the inverse of rgf_unrank_dc
+	int n = rgf.size();
+	fmpz_zero(rankOut);
+	if (n <= 1) return;
+	fmpz* weights = _fmpz_vec_init(k+2);
+	rgf_prefix_weights(rgf.data()+1, n-1, 1, k, weights);
+	fmpz_set(rankOut, weights+k);
+	_fmpz_vec_clear(weights, k+2);
+}
+
+template <typename Sym>
+void rgf_unrank_dc(fmpz_t rank, int n, int k, std::vector<Sym>& rgfOut) {
+	//Quasi-linear unranking, (for k <= RGF_DC_MAX_K), by splitting the sequence in halves
+	rgfOut[0] = 1;
+	rgf_unrank_dc_rest(rank, 1, n, 1, k, rgfOut, NULL);
+}
+
+template <typename Sym>
+bool rgf_unrank_dc_opt(fmpz_t rank, int n, int k, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy) {
+	//Same as rgf_unrank_row_opt, (including abandoning), but with the divide-and-conquer unranking.
+	//Values are applied in one pass at the end, since the halves aren't final until they're corrected
+	rgfOut[0] = 1;
+	RgfEntropyBound bound(n, k, maxEntropy);
+	rgf_unrank_dc_rest(rank, 1, n, 1, k, rgfOut, maxEntropy < NO_ENTROPY_BOUND? &bound : NULL);
+	if (bound.abandoned) return false;
+	
+	for (int i = 0; i < n; i++) {
+		int sym = rgfOut[i]-1;
+		rgfOut[i] = combVals[invPerm[sym]];
+		countsOut[sym]++;
+	}
+	return true;
+}
+
+#define RGF_INSTANTIATE(Sym) \
+	template void rgf_rank(std::vector<Sym>& rgf, int k, fmpz_t rankOut); \
+	template void rgf_rank_table(std::vector<Sym>& rgf, int k, fmpz_mat_t table, fmpz_t rankOut); \
+	template void rgf_rank_row(std::vector<Sym>& rgf, int k, fmpz_mat_t row, fmpz_t rankOut); \
+	template void rgf_rank_tail(std::vector<Sym>& rgf, int start, int k, fmpz_t rankOut); \
+	template void rgf_unrank(fmpz_t rank, int n, int k, std::vector<Sym>& rgfOut); \
+	template bool rgf_unrank_opt(fmpz_t rank, int n, int k, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy); \
+	template void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<Sym>& rgfOut); \
+	template void rgf_unrank_row(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<Sym>& rgfOut); \
+	template bool rgf_unrank_row_opt(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy); \
+	template void rgf_unrank_tail(fmpz_t rank, int start, int n, int k, std::vector<Sym>& rgfOut); \
+	template void rgf_prefix_weights(const Sym* digits, int len, int m, int k, fmpz* weightsOut); \
+	template void rgf_rank_dc(std::vector<Sym>& rgf, int k, fmpz_t rankOut); \
+	template void rgf_unrank_dc(fmpz_t rank, int n, int k, std::vector<Sym>& rgfOut); \
+	template bool rgf_unrank_dc_opt(fmpz_t rank, int n, int k, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy);
+
+RGF_INSTANTIATE(uint8_t)
+RGF_INSTANTIATE(uint16_t)
\ No newline at end of file
@@ -5,21 +5,70 @@
 #include <stdio.h>
 #include "flint/fmpz.h"
 #include "flint/fmpz_mat.h"
+#include "flint/fmpz_vec.h"
 #include "flint/arith.h"
+#include "base_lib.h"
+
+struct RgfRow {
+	//Two rows, (current and previous, as in the two-row fmpz_mat_t), with all the entries in one limb buffer.
+	//Every entry gets the same number of limbs, since entries only shrink as the row is downgraded
+	int k;
+	slong width; //Limbs per entry
+	uint8_t cur; //Which of the two rows is current
+	std::vector<mp_limb_t> limbs; //[row][col][width]
+	std::vector<slong> sizes; //[row][col] - limbs in use
+};
 
 void gen_rgf_table(int n, int k, fmpz_mat_t tableOut);
 void gen_rgf_row_old(int n, int k, uint8_t& CUR, fmpz_mat_t rowOut); //DEPRECATED
 void gen_rgf_row(int n, int k, fmpz_mat_t rowOut); 
 void gen_rgf_cell(int n, int k, int level, fmpz_mat_t rowOut); 
+void load_rgf_table(const char* dir, int n, int k, fmpz_mat_t tableOut); //Use Table Store, (opt-in - the engines still generate their rows)
+void load_rgf_row(const char* dir, int n, int k, fmpz_mat_t rowOut); //Use Table Store, (opt-in)
+bool load_rgf_stored(const char* dir, int n, int k, int engine, fmpz_mat_t matOut);
+void gen_rgf_cell_powers(int k, int level, fmpz_mat_t powers, fmpz_mat_t rowOut); //Use Precomputed Powers
+void gen_rgf_powers(int n, int k, fmpz_mat_t powersOut);
 	
 
-void rgf_rank(std::vector<uint8_t>& rgf, int k, fmpz_t rankOut);
-void rgf_rank_table(std::vector<uint8_t>& rgf, int k, fmpz_mat_t table, fmpz_t rankOut); //Use Precomputed Table
-void rgf_rank_row(std::vector<uint8_t>& rgf, int k, fmpz_mat_t row, fmpz_t rankOut); //Use Precomputed Row
+//The digit functions are templated on the symbol type, (instantiated for uint8_t and uint16_t in rgf.cpp)
+template <typename Sym>
+void rgf_rank(std::vector<Sym>& rgf, int k, fmpz_t rankOut);
+template <typename Sym>
+void rgf_rank_table(std::vector<Sym>& rgf, int k, fmpz_mat_t table, fmpz_t rankOut); //Use Precomputed Table
+template <typename Sym>
+void rgf_rank_row(std::vector<Sym>& rgf, int k, fmpz_mat_t row, fmpz_t rankOut); //Use Precomputed Row
+template <typename Sym>
+void rgf_rank_tail(std::vector<Sym>& rgf, int start, int k, fmpz_t rankOut); //Once all k blocks are open
+
+
+template <typename Sym>
+void rgf_unrank(fmpz_t rank, int n, int k, std::vector<Sym>& rgfOut);
+template <typename Sym>
+bool rgf_unrank_opt(fmpz_t rank, int n, int k, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy = NO_ENTROPY_BOUND);
+template <typename Sym>
+void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<Sym>& rgfOut);
+template <typename Sym>
+void rgf_unrank_row(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<Sym>& rgfOut);
+template <typename Sym>
+bool rgf_unrank_row_opt(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy = NO_ENTROPY_BOUND);
+template <typename Sym>
+void rgf_unrank_tail(fmpz_t rank, int start, int n, int k, std::vector<Sym>& rgfOut); //Once all k blocks are open
 
+void rgf_row_init(RgfRow& rowOut, fmpz_mat_t row, int k);
+mp_limb_t* rgf_row_limbs(RgfRow& row, int r, int col);
+mpz_srcptr rgf_row_entry(RgfRow& row, int col, mpz_t view);
+void rgf_row_downgrade(RgfRow& row, int currentMax);
+slong rgf_sub_divexact_ui(mp_limb_t* out, const mp_limb_t* a, slong aSize, const mp_limb_t* b, slong bSize, ulong m);
 
-void rgf_unrank(fmpz_t rank, int n, int k, std::vector<uint8_t>& rgfOut);
-void rgf_unrank_opt(fmpz_t rank, int n, int k, std::vector<uint8_t>& combVals, std::vector<uint8_t>& invPerm, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut);
-void rgf_unrank_table(fmpz_t rank, int n, int k, fmpz_mat_t table, std::vector<uint8_t>& rgfOut);
-void rgf_unrank_row(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<uint8_t>& rgfOut);
-void rgf_unrank_row_opt(fmpz_t rank, int n, int k, fmpz_mat_t row, std::vector<uint8_t>& combVals, std::vector<uint8_t>& invPerm, std::vector<int>& countsOut, std::vector<uint8_t>& rgfOut);
\ No newline at end of file
+//Divide-and-conquer ranking/unranking, (used automatically for long sequences that saturate late)
+void rgf_advance_row(fmpz* term, int len, int k, fmpz* rowOut);
+template <typename Sym>
+void rgf_prefix_weights(const Sym* digits, int len, int m, int k, fmpz* weightsOut);
+template <typename Sym>
+void rgf_rank_dc(std::vector<Sym>& rgf, int k, fmpz_t rankOut);
+template <typename Sym>
+void rgf_unrank_dc(fmpz_t rank, int n, int k, std::vector<Sym>& rgfOut);
+template <typename Sym>
+bool rgf_unrank_dc_opt(fmpz_t rank, int n, int k, std::vector<Sym>& combVals, std::vector<Sym>& invPerm, std::vector<int>& countsOut, std::vector<Sym>& rgfOut, double maxEntropy = NO_ENTROPY_BOUND);
+void set_rgf_dc_guard(int bits); //Guard bits for the first halves, (RGF_DC_GUARD by default - fewer forces the corrections and the stepwise fallback, for tests)
+int get_rgf_dc_guard();
\ No newline at end of file
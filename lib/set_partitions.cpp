@@ -1,11 +1,28 @@
 #include "set_partitions.h"
 #include <iostream>
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <thread>
+#include <atomic>
 
 using std::cout, std::endl;
 
+const slong STIRLING_TABLE_MAX_WORDS = 1 << 26; //Cap on the cached DP tables, (512MB per thread - it also caps a single table)
+const slong EGF_CACHE_MAX_WORDS = 1 << 24; //Cap on the cached EGF powers, (128MB in all, split between the threads)
+
+std::atomic<int> stirlingEngine{STIRLING_ENGINE_NMOD}; //Count over the integers mod word-size primes by default, (atomic, the pool workers read it)
+
+void set_stirling_engine(int engine) {
+	stirlingEngine.store(engine, std::memory_order_relaxed);
+}
+int get_stirling_engine() {
+	return stirlingEngine.load(std::memory_order_relaxed);
+}
+
 void gen_k_facts(int k, fmpz_mat_t kFactsOut) {
 	fmpz_mat_init(kFactsOut, 1, k+1);
-	
+	fmpz_one(fmpz_mat_entry(kFactsOut, 0, 0));
 	for (int i = 1; i <= k; i++) {			
 		fmpz_fac_ui(fmpz_mat_entry(kFactsOut, 0, i), i);		
 	}
@@ -31,6 +48,12 @@ void gen_coeffs(int m, fmpq_mat_t coeffsOut) {
 }
 
 void stirling2_max_lt(int n, int k, int m, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut) { //Polynomial EGF
+	int engine = stirlingEngine.load(std::memory_order_relaxed);
+	if (engine == STIRLING_ENGINE_TABLE && stirling2_max_lt_table(n, k, m, countOut)) return;
+	if (engine == STIRLING_ENGINE_FMPQ) stirling2_max_lt_fmpq(n, k, m, nFact, kFact, coeffs, countOut);
+	else stirling2_max_lt_nmod(n, k, m, nFact, kFact, countOut);
+}
+void stirling2_max_lt_fmpq(int n, int k, int m, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut) { //Polynomial EGF
 	fmpz_zero(countOut);
 	if (k > n) return;
 	else if (m <= 0) return;
@@ -163,6 +186,12 @@ void stirling2_max_initial_lt(int n, int k, int m, int r, fmpz_t nFact, fmpz_t k
 }
 */
 void stirling2_max_initial_lt(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut) { //Q-nomial EGF
+	int engine = stirlingEngine.load(std::memory_order_relaxed);
+	if (engine == STIRLING_ENGINE_TABLE && stirling2_max_initial_lt_table(n, k, m, r, countOut)) return;
+	if (engine == STIRLING_ENGINE_FMPQ) stirling2_max_initial_lt_fmpq(n, k, m, r, nFact, kFact, coeffs, countOut);
+	else stirling2_max_initial_lt_nmod(n, k, m, r, nFact, kFact, countOut);
+}
+void stirling2_max_initial_lt_fmpq(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut) { //Q-nomial EGF
 	//This calculates the Stirling2 number of set-parts with n elements, k parts, 
 	//and having a max part size that is exactly m, and that has an initial part size less-than r
 	fmpz_zero(countOut);
@@ -242,6 +271,287 @@ void stirling2_max_initial_lt(int n, int k, int m, int r, fmpz_t nFact, fmpz_t k
 	fmpq_poly_clear(polyQ);
 	
 }
+void stirling2_max_lt_nmod(int n, int k, int m, fmpz_t nFact, fmpz_t kFact, fmpz_t countOut) { //Polynomial EGF
+	//Same as stirling2_max_lt_fmpq, but over the integers
+	fmpz_zero(countOut);
+	if (k > n) return;
+	else if (m <= 0) return;
+	stirling2_nmod(n, k, m, 0, false, nFact, kFact, countOut);
+}
+
+void stirling2_max_initial_lt_nmod(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpz_t countOut) { //Q-nomial EGF
+	//Same as stirling2_max_initial_lt_fmpq, but over the integers
+	fmpz_zero(countOut);
+	// Edge Cases
+	if (k < 0) return;
+	else if (k > n) return;
+	else if (n == 0) {
+		if (k == 0) fmpz_one(countOut);
+		return;		
+	}
+	else if (k == 0) return;
+	else if (r > m) return;
+	stirling2_nmod(n, k, m, r, true, nFact, kFact, countOut);
+}
+
+//Truncated powers of the (scaled) EGF A(x) = m! * B_m(x), shared by every count made on this thread, 
+//(ranking and unranking alike).  Bisecting on m and r keeps asking for the same few powers, and each 
+//part needs A^k for its max part section, and then A^(k-1) for its initial part section
+struct EgfPower {
+	int trunc = 0;
+	std::vector<nmod_poly_struct> polys; //One per prime, (in the same order as EgfPowerCache::primes)
+	EgfPower() = default;
+	EgfPower(const EgfPower&) = delete;
+	EgfPower& operator=(const EgfPower&) = delete;
+	~EgfPower() { 
+		for (nmod_poly_struct& poly : polys) nmod_poly_clear(&poly); 
+	}
+};
+struct EgfPowerCache {
+	std::vector<ulong> primes;
+	std::map<std::pair<int, int>, EgfPower> powers; //By (m, power)
+	slong words = 0;
+};
+thread_local EgfPowerCache egfPowerCache;
+
+slong egf_cache_max_words() {
+	//The cache is thread_local, and the pool keeps a worker on every core, so each thread gets its share
+	static const slong threadWords = EGF_CACHE_MAX_WORDS / std::max(1u, std::thread::hardware_concurrency());
+	return threadWords;
+}
+
+EgfPower* find_egf_power(int m, int power, int trunc, int primeCount) {
+	auto found = egfPowerCache.powers.find({m, power});
+	if (found == egfPowerCache.powers.end()) return NULL;
+	EgfPower& egf = found->second;
+	if (egf.trunc < trunc || (int)egf.polys.size() < primeCount) return NULL;
+	return &egf;
+}
+
+EgfPower& get_egf_power(int m, int power, int trunc, int primeCount) {
+	EgfPowerCache& cache = egfPowerCache;
+	while ((int)cache.primes.size() < primeCount) {
+		ulong prime = cache.primes.empty()? UWORD(1) << (FLINT_BITS - 2) : cache.primes.back();
+		cache.primes.push_back(n_nextprime(prime, 1));
+	}
+	EgfPower* egf = find_egf_power(m, power, trunc, primeCount);
+	if (egf != NULL) return *egf;
+	
+	//Step from a neighbouring power if there is one, (A has a constant term of m!, so it can be divided by)
+	EgfPower* above = m > 0? find_egf_power(m, power+1, trunc, primeCount) : NULL;
+	EgfPower* below = power > 0? find_egf_power(m, power-1, trunc, primeCount) : NULL;
+	
+	std::vector<nmod_poly_struct> polys(primeCount);
+	std::vector<ulong> scaled(m+1);
+	for (int j = 0; j < primeCount; j++) {
+		ulong prime = cache.primes[j];
+		nmod_t mod;
+		nmod_init(&mod, prime);
+		
+		// scaled[i] = m!/i!
+		scaled[m] = 1;
+		for (int i = m-1; i >= 0; i--) scaled[i] = nmod_mul(scaled[i+1], i+1, mod);
+		
+		// A(x) = m! * (x/1! + x^2/2! + ... + x^m/m!), (with x factored out)
+		nmod_poly_t base;
+		nmod_poly_init2(base, prime, m);
+		for (int i = 0; i < m; i++) nmod_poly_set_coeff_ui(base, i, scaled[i+1]);
+		
+		nmod_poly_init2(&polys[j], prime, trunc);
+		if (above != NULL) nmod_poly_div_series(&polys[j], &above->polys[j], base, trunc);
+		else if (below != NULL) nmod_poly_mullow(&polys[j], &below->polys[j], base, trunc);
+		else if (power == 0) nmod_poly_one(&polys[j]);
+		else nmod_poly_pow_trunc(&polys[j], base, power, trunc);
+		nmod_poly_clear(base);
+	}
+	
+	//Keep the cache bounded, (anything above or below was copied from by now)
+	slong words = (slong)primeCount * trunc;
+	auto old = cache.powers.find({m, power});
+	if (old != cache.powers.end()) {
+		cache.words -= (slong)old->second.polys.size() * old->second.trunc;
+		cache.powers.erase(old);
+	}
+	if (cache.words + words > egf_cache_max_words()) {
+		cache.powers.clear();
+		cache.words = 0;
+	}
+	EgfPower& entry = cache.powers[{m, power}];
+	entry.trunc = trunc;
+	entry.polys = std::move(polys);
+	cache.words += words;
+	return entry;
+}
+
+void stirling2_nmod(int n, int k, int m, int r, bool initial, fmpz_t nFact, fmpz_t kFact, fmpz_t countOut) {
+	//Shared by stirling2_max_lt_nmod and stirling2_max_initial_lt_nmod, (r is only used if initial).
+	//Scaling the EGF coefficients 1/i! by m! makes them integers, m!/i!, so the coefficient of x^(n-k) 
+	//picks up (m!)^k.  Each prime gives count = nFact * coeff / (kFact * (m!)^k) mod p, (the primes are 
+	//far bigger than m and k, so the division is always possible), and CRT joins them back up
+	int targetIndex = n - k;
+	int power = initial? k-1 : k;
+	slong bits = (slong)n * FLINT_BIT_COUNT(k) + 2; //count <= S2(n,k) <= k^n
+	int primeCount = bits / (FLINT_BITS - 2) + 1; //Every prime is over 2^(FLINT_BITS-2)
+	EgfPower& egf = get_egf_power(m, power, targetIndex+1, primeCount);
+	
+	std::vector<ulong> scaled(m+1);
+	fmpz_t modulus;
+	fmpz_init(modulus);
+	fmpz_one(modulus);
+	for (int j = 0; j < primeCount; j++) {
+		ulong prime = egfPowerCache.primes[j];
+		nmod_t mod;
+		nmod_init(&mod, prime);
+		nmod_poly_struct* poly = &egf.polys[j];
+		
+		// scaled[i] = m!/i!
+		scaled[m] = 1;
+		for (int i = m-1; i >= 0; i--) scaled[i] = nmod_mul(scaled[i+1], i+1, mod);
+		
+		ulong coeff = 0;
+		if (!initial) coeff = nmod_poly_get_coeff_ui(poly, targetIndex);
+		else {
+			//Only one coefficient of Q(x) * B(x)^(k-1) is needed, where Q(x) = sum(x^i/i!) for i in [r-1, m)
+			for (int i = std::max(r-1, 0); i < m && i <= targetIndex; i++) {
+				coeff = nmod_add(coeff, nmod_mul(scaled[i], nmod_poly_get_coeff_ui(poly, targetIndex-i), mod), mod);
+			}
+		}
+		
+		ulong den = nmod_mul(fmpz_fdiv_ui(kFact, prime), n_powmod2_ui_preinv(scaled[0], k, prime, n_preinvert_limb(prime)), mod);
+		ulong count = nmod_mul(nmod_mul(fmpz_fdiv_ui(nFact, prime), coeff, mod), n_invmod(den, prime), mod);
+		
+		fmpz_CRT_ui(countOut, countOut, modulus, count, prime, 0);
+		fmpz_mul_ui(modulus, modulus, prime);
+	}
+	fmpz_clear(modulus);
+}
+
+void gen_stirling_table(int m, int kMax, int dMax, fmpz_mat_t tableOut) {
+	//tableOut[k][d] is the number of set-parts with k+d elements, k parts, and no part bigger than m, 
+	//(indexing by d = n-k keeps it to the band the EGF targets can actually reach).  The last element either 
+	//starts a part of its own, or joins one of the k parts - less the ways that would make a part of m+1:
+	//S(n,k) = k*S(n-1,k) + S(n-1,k-1) - C(n-1,m)*S(n-1-m,k-1)
+	fmpz_mat_init(tableOut, kMax+1, dMax+1);
+	
+	// binoms[j] = C(j, m)
+	int jMax = kMax + dMax;
+	fmpz* binoms = _fmpz_vec_init(jMax+1);
+	for (int j = std::max(m, 0); j <= jMax; j++) {
+		if (j == m) fmpz_one(binoms + j);
+		else {
+			fmpz_mul_ui(binoms + j, binoms + j-1, j);
+			fmpz_divexact_ui(binoms + j, binoms + j, j-m);
+		}
+	}
+	
+	fmpz_one(fmpz_mat_entry(tableOut, 0, 0));
+	for (int k = 1; k <= kMax; k++) {
+		for (int d = 0; d <= dMax; d++) {
+			fmpz* cell = fmpz_mat_entry(tableOut, k, d);
+			fmpz_set(cell, fmpz_mat_entry(tableOut, k-1, d));
+			if (d > 0) fmpz_addmul_ui(cell, fmpz_mat_entry(tableOut, k, d-1), k);
+			if (d >= m) fmpz_submul(cell, binoms + k+d-1, fmpz_mat_entry(tableOut, k-1, d-m));
+		}
+	}
+	_fmpz_vec_clear(binoms, jMax+1);
+}
+
+//DP tables by m, shared by every count made on this thread, (like the EGF powers).  
+//A table built for a bigger k and d answers all of the smaller ones too
+struct StirlingTable {
+	fmpz_mat_t counts;
+	slong words = 0;
+	StirlingTable() { 
+		fmpz_mat_init(counts, 0, 0); 
+	}
+	StirlingTable(const StirlingTable&) = delete;
+	StirlingTable& operator=(const StirlingTable&) = delete;
+	~StirlingTable() { 
+		fmpz_mat_clear(counts); 
+	}
+};
+struct StirlingTableCache {
+	std::map<int, StirlingTable> tables; //By m
+	slong words = 0;
+};
+thread_local StirlingTableCache stirlingTableCache;
+
+fmpz_mat_struct* get_stirling_table(int m, int k, int d) {
+	//Returns NULL if the table would be too big to keep
+	StirlingTableCache& cache = stirlingTableCache;
+	auto found = cache.tables.find(m);
+	int kMax = k;
+	int dMax = d;
+	if (found != cache.tables.end()) {
+		fmpz_mat_struct* counts = found->second.counts;
+		if (fmpz_mat_nrows(counts) > k && fmpz_mat_ncols(counts) > d) return counts;
+		kMax = std::max(kMax, (int)fmpz_mat_nrows(counts) - 1);
+		dMax = std::max(dMax, (int)fmpz_mat_ncols(counts) - 1);
+	}
+	
+	//Every count is under k^n, (which is rough, but it only has to keep the table from blowing up)
+	slong words = (slong)(kMax+1) * (dMax+1) * ((slong)(kMax+dMax) * FLINT_BIT_COUNT(kMax) / FLINT_BITS + 1);
+	if (words > STIRLING_TABLE_MAX_WORDS) return NULL;
+	if (found != cache.tables.end()) {
+		cache.words -= found->second.words;
+		cache.tables.erase(found);
+	}
+	if (cache.words + words > STIRLING_TABLE_MAX_WORDS) {
+		cache.tables.clear();
+		cache.words = 0;
+	}
+	StirlingTable& table = cache.tables[m];
+	fmpz_mat_clear(table.counts);
+	gen_stirling_table(m, kMax, dMax, table.counts);
+	table.words = words;
+	cache.words += words;
+	return table.counts;
+}
+
+bool stirling2_max_lt_table(int n, int k, int m, fmpz_t countOut) { //DP table
+	//Same as stirling2_max_lt_nmod, but looked up.  Returns false if the table would be too big
+	fmpz_zero(countOut);
+	if (k > n) return true;
+	else if (m <= 0) return true;
+	
+	m = std::min(m, n-k+1); //No part can be bigger than this anyway, (so there are fewer tables)
+	fmpz_mat_struct* table = get_stirling_table(m, k, n-k);
+	if (table == NULL) return false;
+	fmpz_set(countOut, fmpz_mat_entry(table, k, n-k));
+	return true;
+}
+
+bool stirling2_max_initial_lt_table(int n, int k, int m, int r, fmpz_t countOut) { //DP table
+	//Same as stirling2_max_initial_lt_nmod, but summed from the table.  Returns false if the table would be too big.
+	//An initial part of size s takes s-1 of the other n-1 elements, and the rest go into k-1 parts, 
+	//so the count is sum(C(n-1, s-1) * S(n-s, k-1)) for s in [r, m]
+	fmpz_zero(countOut);
+	// Edge Cases
+	if (k < 0) return true;
+	else if (k > n) return true;
+	else if (n == 0) {
+		if (k == 0) fmpz_one(countOut);
+		return true;		
+	}
+	else if (k == 0) return true;
+	else if (r > m) return true;
+	
+	m = std::min(m, n-k+1);
+	fmpz_mat_struct* table = get_stirling_table(m, k-1, n-k);
+	if (table == NULL) return false;
+	
+	fmpz_t binom;
+	fmpz_init(binom);
+	fmpz_one(binom);
+	for (int s = 1; s <= m; s++) {
+		if (s >= r) fmpz_addmul(countOut, binom, fmpz_mat_entry(table, k-1, n-k-(s-1)));
+		fmpz_mul_ui(binom, binom, n-s);
+		fmpz_divexact_ui(binom, binom, s);
+	}
+	fmpz_clear(binom);
+	return true;
+}
+
 void stirling2_max_initial_ge(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut) {
 	//This calculates the Stirling2 number of set-parts with n elements, k parts, 
 	//and having a max part size that is exactly m, and that has an initial part size greater-than-or-equal to r
@@ -265,14 +575,42 @@ void stirling2_max_initial_gt(int n, int k, int m, int r, fmpz_t nFact, fmpz_t k
 
 
 
-void printSetPart(std::vector<std::set<int>>& setPart) {
+void gen_flat_set_part(std::vector<int>& seqParts, int parts, FlatSetPart& setPartOut) {
+	//seqParts[i] is the part that element i is in.  Counting the parts gives the offsets, 
+	//and then a pass in element order drops each one into place, (so every part comes out sorted)
+	setPartOut.parts = parts;
+	setPartOut.offsets.assign(parts+1, 0);
+	for (int part : seqParts) setPartOut.offsets[part+1]++;
+	for (int p = 0; p < parts; p++) setPartOut.offsets[p+1] += setPartOut.offsets[p];
+	
+	setPartOut.elements.resize(seqParts.size());
+	std::vector<int> next(setPartOut.offsets.begin(), setPartOut.offsets.end()-1);
+	for (int i = 0; i < (int)seqParts.size(); i++) {
+		setPartOut.elements[next[seqParts[i]]++] = i;
+	}
+	
+	setPartOut.largestFrom.assign(parts+1, -1);
+	for (int p = parts-1; p >= 0; p--) {
+		setPartOut.largestFrom[p] = std::max(setPartOut.largestFrom[p+1], set_part_size(setPartOut, p));
+	}
+}
+
+const int* set_part_elements(FlatSetPart& setPart, int p) {
+	return setPart.elements.data() + setPart.offsets[p];
+}
+
+int set_part_size(FlatSetPart& setPart, int p) {
+	return setPart.offsets[p+1] - setPart.offsets[p];
+}
+
+void printSetPart(FlatSetPart& setPart) {
 	cout << "Set Part: " << endl;
-	for (int p = 0; p < (int)setPart.size(); p++) {
+	for (int p = 0; p < setPart.parts; p++) {
 		cout << "Part: " << p << " [";
-		std::set<int> part = setPart[p];
+		const int* part = set_part_elements(setPart, p);
 		
-		for (const int element : part) {
-			cout << +element << ",";         
+		for (int e = 0; e < set_part_size(setPart, p); e++) {
+			cout << +part[e] << ",";         
 		}		
 		cout << "]" << endl;
 	}
@@ -280,14 +618,8 @@ void printSetPart(std::vector<std::set<int>>& setPart) {
 	cout << endl;
 }
 
-int get_size_of_largest_part(std::vector<std::set<int>>& setPart, int start) {
-	int largestPart = -1;	
-	
-	for (int i = start; i < (int)setPart.size(); i++) {
-		std::set<int> part = setPart[i];
-		if ((int)part.size() > largestPart) largestPart = part.size();
-	}	
-	return largestPart;
+int get_size_of_largest_part(FlatSetPart& setPart, int start) {
+	return setPart.largestFrom[start];
 }
 
 
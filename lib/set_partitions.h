@@ -10,26 +10,54 @@
 #include "flint/fmpz.h"
 #include "flint/fmpq.h"
 #include "flint/fmpz_mat.h"
+#include "flint/fmpz_vec.h"
 #include "flint/fmpq_mat.h"
 #include "flint/fmpq_poly.h"
+#include "flint/nmod_poly.h"
+#include "flint/ulong_extras.h"
+
+struct FlatSetPart {
+	//Set partition with every part's elements in one sorted array, one part after another, (CSR)
+	int parts;
+	std::vector<int> offsets; //[parts+1] - part p is elements[offsets[p], offsets[p+1])
+	std::vector<int> elements;
+	std::vector<int> largestFrom; //[parts+1] - size of the largest part in [p, parts), (suffix max)
+};
+
+const int STIRLING_ENGINE_FMPQ = 0; //EGF over the rationals
+const int STIRLING_ENGINE_NMOD = 1; //EGF over the integers mod word-size primes, (the default)
+const int STIRLING_ENGINE_TABLE = 2; //DP table lookups, (falls back to nmod if a table would be too big)
 
 
 
 void gen_k_facts(int k, fmpz_mat_t kFactsOut); 
 void gen_coeffs(int m, fmpq_mat_t coeffsOut); 
+void gen_stirling_table(int m, int kMax, int dMax, fmpz_mat_t tableOut);
+void set_stirling_engine(int engine); //Safe to switch mid-run, (each count reads it once)
+int get_stirling_engine();
 
 
 
 void stirling2_max_lt (int n, int k, int m, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut); //Polynomial EGF
+void stirling2_max_lt_fmpq(int n, int k, int m, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut); //Over the rationals
+void stirling2_max_lt_nmod(int n, int k, int m, fmpz_t nFact, fmpz_t kFact, fmpz_t countOut); //Multi-modular
+bool stirling2_max_lt_table(int n, int k, int m, fmpz_t countOut); //DP table
 void stirling2_max_between(int n, int k, int mHi, int mLo, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut);
 
 
 void stirling2_max_initial_lt(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut); //Q-nomial EGF
+void stirling2_max_initial_lt_fmpq(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut); //Over the rationals
+void stirling2_max_initial_lt_nmod(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpz_t countOut); //Multi-modular
+bool stirling2_max_initial_lt_table(int n, int k, int m, int r, fmpz_t countOut); //DP table
+void stirling2_nmod(int n, int k, int m, int r, bool initial, fmpz_t nFact, fmpz_t kFact, fmpz_t countOut);
 void stirling2_max_initial_ge(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut);
 void stirling2_max_initial_gt(int n, int k, int m, int r, fmpz_t nFact, fmpz_t kFact, fmpq_mat_t coeffs, fmpz_t countOut);
 
-void printSetPart(std::vector<std::set<int>>& setPart);
-int get_size_of_largest_part(std::vector<std::set<int>>& setPart, int start);
+void gen_flat_set_part(std::vector<int>& seqParts, int parts, FlatSetPart& setPartOut);
+const int* set_part_elements(FlatSetPart& setPart, int p);
+int set_part_size(FlatSetPart& setPart, int p);
+void printSetPart(FlatSetPart& setPart);
+int get_size_of_largest_part(FlatSetPart& setPart, int start);
 
 /*
 //Old / Non-Precached
@@ -0,0 +1,118 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+thread_local bool inPoolTask = false; //Batches started from inside a task just run in place, (rather than deadlock)
+
+void thread_pool_drain(ThreadPool& pool, const std::function<void(int)>& task, int count) {
+	//Take indexes until they run out, (the caller works on its own batch as well)
+	int done = 0;
+	for (int i = pool.next++; i < count; i = pool.next++) {
+		task(i);
+		done++;
+	}
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	pool.pending -= done;
+	if (pool.pending == 0) pool.finished.notify_all();
+}
+
+void thread_pool_work(ThreadPool& pool) {
+	inPoolTask = true;
+	uint64_t seen = 0;
+	while (true) {
+		const std::function<void(int)>* task;
+		int count;
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			pool.wake.wait(lock, [&] { return pool.stopping || (pool.batch != seen && pool.pending > 0); });
+			if (pool.stopping) return;
+			seen = pool.batch;
+			task = pool.task;
+			count = pool.count;
+			pool.active++;
+		}
+		thread_pool_drain(pool, *task, count);
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			pool.active--;
+			if (pool.active == 0) pool.finished.notify_all();
+		}
+	}
+}
+
+ThreadPool::ThreadPool(int threadCount) {
+	for (int i = 0; i < threadCount; i++) {
+		threads.emplace_back(thread_pool_work, std::ref(*this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
+
+ThreadPool& get_thread_pool() {
+	//The caller takes a share of every batch too, so that's one less worker than cores
+	static ThreadPool pool(std::max(1, (int)std::thread::hardware_concurrency()) - 1);
+	return pool;
+}
+
+void thread_pool_run(ThreadPool& pool, int count, const std::function<void(int)>& task) {
+	if (inPoolTask || pool.threads.empty() || count <= 1) {
+		for (int i = 0; i < count; i++) task(i);
+		return;
+	}
+	std::lock_guard<std::mutex> run(pool.runMutex);
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.task = &task;
+		pool.count = count;
+		pool.next = 0;
+		pool.pending = count;
+		pool.batch++;
+	}
+	pool.wake.notify_all();
+	inPoolTask = true;
+	thread_pool_drain(pool, task, count);
+	inPoolTask = false;
+	
+	//Wait for the workers to leave as well, so none of them are still holding this task
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.finished.wait(lock, [&] { return pool.pending == 0 && pool.active == 0; });
+	pool.task = NULL;
+}
+
+void thread_pool_run_ordered(ThreadPool& pool, int count, int window, const std::function<void(int)>& task, const std::function<void(int)>& emit) {
+	//Tasks finish in any order, but emit(i) is called in index order, one at a time, (by whichever thread finished the one being waited on).
+	//No task starts more than window ahead of the last one emitted, so the caller only needs window slots of output, (slot i % window)
+	std::mutex mutex;
+	std::condition_variable room;
+	std::vector<char> done(window, false);
+	int emitted = 0;
+	bool emitting = false;
+	thread_pool_run(pool, count, [&](int i) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			room.wait(lock, [&] { return i < emitted + window; });
+		}
+		task(i);
+		
+		std::unique_lock<std::mutex> lock(mutex);
+		done[i % window] = true;
+		if (emitting) return; //It'll get picked up
+		emitting = true;
+		while (emitted < count && done[emitted % window]) {
+			int ready = emitted;
+			lock.unlock();
+			emit(ready);
+			lock.lock();
+			done[ready % window] = false;
+			emitted++;
+			room.notify_all();
+		}
+		emitting = false;
+	});
+}
\ No newline at end of file
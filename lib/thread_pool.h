@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+struct ThreadPool {
+	//Workers that stay up between batches, (so their thread_local caches stay warm).
+	//A batch is task(0) ... task(count-1), handed out one index at a time
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::mutex runMutex; //One batch at a time
+	std::condition_variable wake;
+	std::condition_variable finished;
+	const std::function<void(int)>* task = NULL;
+	int count = 0;
+	std::atomic<int> next{0};
+	int pending = 0; //Tasks in the batch that haven't finished
+	int active = 0; //Workers still inside the batch
+	uint64_t batch = 0;
+	bool stopping = false;
+	
+	ThreadPool(int threadCount);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+};
+
+ThreadPool& get_thread_pool(); //Shared, one worker per core
+void thread_pool_run(ThreadPool& pool, int count, const std::function<void(int)>& task);
+void thread_pool_run_ordered(ThreadPool& pool, int count, int window, const std::function<void(int)>& task, const std::function<void(int)>& emit);
\ No newline at end of file
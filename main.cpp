@@ -6,21 +6,126 @@
 #include <string>
 #include <fstream>
 #include <cassert>
+#include <cstring>
+#include <chrono>
 #include "flint/fmpz.h"
 #include "flint/fmpz_mat.h"
 #include "flint/arith.h"
 #include "lib/base_lib.h"
 #include "lib/nearer_entropic.h"
+#include "lib/block_stream.h"
+#include "lib/io_lib.h"
 using std::cout, std::endl;
 
 const int SEQ_LEN = 100;
 const int MAX_SYM = 16;
 const int K_SEARCH = 5;
 const bool VERIFY = true;
+const bool EARLY_ABANDON = true; //Stop unranking a K candidate once it can no longer beat the best delta
+const uint64_t RANGE_CHUNK = 1 << 20; //Bytes decoded at a time for a range
 
 
 
-int main() {
+void print_usage() {
+	cout << "Usage: decimate encode <input> <output> [-b blockSize] [-k kSearch] [-e near|nearer] [-t threads] [-w window] [-v]" << endl;
+	cout << "       decimate decode <input> <output> [-s start -l length] [-t threads] [-w window]" << endl;
+	cout << "       decimate, (no arguments runs the demo on a random sequence)" << endl;
+}
+
+int run_range(const char* inFilename, const char* outFilename, long long start, long long length, BlockStreamOptions& options) {
+	//Just the blocks that overlap the range get decoded, (through the index), to the end if there's no length.
+	//It goes out a chunk at a time, so the range doesn't have to fit in memory
+	BlockStreamReader reader;
+	if (!block_stream_open(inFilename, reader)) return 1;
+	uint64_t inputSize = reader.footer->inputSize;
+	if (length < 0) length = (uint64_t)start < inputSize? inputSize - start : 0;
+	if ((uint64_t)start > inputSize || (uint64_t)length > inputSize - start) {
+		block_stream_close(reader);
+		cout << "Range is past the end: " << inputSize << " bytes" << endl;
+		return 1;
+	}
+	std::string tempName;
+	FILE* file = open_temp_file(outFilename, tempName);
+	if (!file) {
+		block_stream_close(reader);
+		perror("Could not open file for writing");
+		return 1;
+	}
+	std::vector<uint8_t> bytes(std::min<uint64_t>(length, RANGE_CHUNK));
+	bool done = true;
+	for (uint64_t pos = 0; done && pos < (uint64_t)length; pos += bytes.size()) {
+		uint64_t chunk = std::min<uint64_t>(length - pos, bytes.size());
+		done = block_stream_read(reader, start + pos, chunk, options, bytes.data());
+		if (done) fwrite(bytes.data(), 1, chunk, file);
+	}
+	block_stream_close(reader);
+	bool written = done && !ferror(file);
+	fclose(file);
+	if (!written || rename(tempName.c_str(), outFilename) != 0) {
+		if (done) perror("Could not write file");
+		else fprintf(stderr, "Invalid stream file: %s\n", inFilename);
+		remove(tempName.c_str());
+		return 1;
+	}
+	cout << "Range: " << start << " - " << start + length << " of " << inputSize << " bytes" << endl;
+	return 0;
+}
+
+int run_stream(int argc, char** argv) {
+	//File to file, (see block_stream.h)
+	bool encode = strcmp(argv[1], "encode") == 0;
+	if ((!encode && strcmp(argv[1], "decode") != 0) || argc < 4) {
+		print_usage();
+		return 1;
+	}
+	BlockStreamOptions options;
+	long long rangeStart = -1;
+	long long rangeLength = -1;
+	for (int i = 4; i < argc; i++) {
+		std::string flag = argv[i];
+		if (flag == "-v") {
+			options.verify = true;
+			continue;
+		}
+		if (i+1 >= argc) {
+			print_usage();
+			return 1;
+		}
+		std::string val = argv[++i];
+		if (flag == "-b") options.blockSize = atoi(val.c_str());
+		else if (flag == "-k") options.kSearch = atoi(val.c_str());
+		else if (flag == "-t") options.threads = atoi(val.c_str());
+		else if (flag == "-w") options.window = atoi(val.c_str());
+		else if (flag == "-s") rangeStart = atoll(val.c_str());
+		else if (flag == "-l") rangeLength = atoll(val.c_str());
+		else if (flag == "-e" && val == "near") options.engine = BLOCK_ENGINE_NEAR;
+		else if (flag == "-e" && val == "nearer") options.engine = BLOCK_ENGINE_NEARER;
+		else {
+			print_usage();
+			return 1;
+		}
+	}
+	
+	if (!encode && (rangeStart >= 0 || rangeLength >= 0)) return run_range(argv[2], argv[3], std::max(rangeStart, 0LL), rangeLength, options);
+	
+	BlockStreamStats stats;
+	auto start = std::chrono::steady_clock::now();
+	bool done;
+	if (encode) done = block_stream_encode(argv[2], argv[3], options, stats);
+	else done = block_stream_decode(argv[2], argv[3], options, stats);
+	if (!done) return 1;
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	
+	uint64_t rawBytes = encode? stats.inputSize : stats.outputSize;
+	cout << "Blocks: " << stats.blockCount << ", In: " << stats.inputSize << " bytes, Out: " << stats.outputSize << " bytes" << endl;
+	if (encode && stats.blockCount > 0) cout << "Mean Delta: " << std::fixed << std::setprecision(4) << stats.deltaSum / stats.blockCount << endl;
+	cout << "Time: " << std::fixed << std::setprecision(2) << seconds << "s, " << rawBytes / std::max(seconds, 1e-9) / 1e6 << " MB/s" << endl;
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc > 1) return run_stream(argc, argv);
+	
 	srand(44); 	
 	std::vector<uint8_t> valSeq(SEQ_LEN);	
 	
@@ -50,7 +155,12 @@ int main() {
 		fmpz_set(normCopy, normRank);
 		std::vector<uint8_t> entSeq(SEQ_LEN+k);
 		std::vector<int> entCounts(MAX_SYM);
-		nearer_entropic_unrank(normCopy, SEQ_LEN+k, MAX_SYM, entCounts, entSeq);		
+		double maxEntropy = NO_ENTROPY_BOUND;
+		if (EARLY_ABANDON && bestK != -1) maxEntropy = valEntropy - bestDelta;
+		if (!nearer_entropic_unrank(normCopy, SEQ_LEN+k, MAX_SYM, entCounts, entSeq, maxEntropy)) {
+			cout << " - Entropy of Ent Seq " << k << ": abandoned" << endl;
+			continue;
+		}
 		double entEntropy = measureEntropy(entCounts, entSeq.size());
 		double delta = valEntropy - entEntropy;
 		if (delta > bestDelta) {
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#include <cassert>
+#include <cstdlib>
+#include <set>
+
+#include "flint/fmpz.h"
+#include "flint/fmpz_mat.h"
+#include "../lib/io_lib.h"
+#include "../lib/base_lib.h"
+
+using std::cout, std::endl;
+
+
+const int BASES[] = {2, 3, 10, 16, 200, 256};
+const int LENS[] = {1, 5, 33, 100, 1000};
+
+
+
+int main() {
+	srand(44);
+	for (int base : BASES) {
+		for (int len : LENS) {
+			std::vector<uint8_t> digits(len);
+			for (int i = 0; i < len; i++) {
+				digits[i] = rand()%base;
+			}
+			
+			fmpz_t n;
+			fmpz_init(n);
+			std::vector<int> counts(256);
+			b2n(digits, base, counts, n);
+			
+			//Check against the place-value definition
+			fmpz_t expected;
+			fmpz_t power;
+			fmpz_init(expected);
+			fmpz_init(power);
+			for (int i = 0; i < len; i++) {
+				fmpz_ui_pow_ui(power, base, i);
+				fmpz_addmul_ui(expected, power, digits[i]);
+			}
+			assert(fmpz_equal(n, expected) && "b2n does not match!");
+			fmpz_clear(expected);
+			fmpz_clear(power);
+			
+			//Round trip through the generic tree path as well as the dispatched one
+			std::vector<uint8_t> decoded(len);
+			n2b(n, base, decoded);
+			assert(decoded == digits && "n2b does not match!");
+			
+			fmpz_mat_t tree;
+			gen_power_tree(base, len, tree);
+			std::vector<uint8_t> treeDecoded(len);
+			n2b_tree(n, base, tree, treeDecoded);
+			assert(treeDecoded == digits && "n2b_tree does not match!");
+			fmpz_mat_clear(tree);
+			
+			cout << "Base: " << base << ", Len: " << len << " OK" << endl;
+			fmpz_clear(n);
+		}
+	}
+	
+	//The indexed bit set should track a std::set, (erasing one at a time and in bulk)
+	for (int len : LENS) {
+		IndexedBits bits;
+		indexed_bits_init(len, bits);
+		std::set<int> expected;
+		for (int i = 0; i < len; i++) expected.insert(i);
+		while (!expected.empty()) {
+			int index = rand() % expected.size();
+			int val = *std::next(expected.begin(), index);
+			assert(indexed_bits_select(bits, index) == val && "select does not match!");
+			assert(indexed_bits_rank(bits, val) == index && "rank does not match!");
+			
+			std::vector<int> vals = {val};
+			for (int i = 0; i < 3 && val+i+1 < len; i++) {
+				if (expected.count(val+i+1)) vals.push_back(val+i+1);
+			}
+			if (vals.size() == 1) indexed_bits_erase(bits, val);
+			else indexed_bits_erase_all(bits, vals);
+			for (int v : vals) expected.erase(v);
+			assert(bits.size == (int)expected.size() && "size does not match!");
+			
+			std::vector<int> listed;
+			indexed_bits_list(bits, listed);
+			assert(listed == std::vector<int>(expected.begin(), expected.end()) && "list does not match!");
+		}
+		cout << "Indexed Bits Len: " << len << " OK" << endl;
+	}
+	return 0;
+}
\ No newline at end of file
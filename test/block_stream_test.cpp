@@ -0,0 +1,139 @@
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include "../lib/block_stream.h"
+
+using std::cout, std::endl;
+
+
+const int FILE_SIZE = 3000;
+const char* IN_FILE = "/tmp/decimate_stream_in";
+const char* ENC_FILE = "/tmp/decimate_stream_enc";
+const char* OUT_FILE = "/tmp/decimate_stream_out";
+
+void write_file(const char* filename, std::vector<uint8_t>& bytes) {
+	FILE* file = fopen(filename, "wb");
+	if (!bytes.empty()) fwrite(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+}
+
+std::vector<uint8_t> read_file(const char* filename) {
+	std::vector<uint8_t> bytes;
+	FILE* file = fopen(filename, "rb");
+	for (int c = fgetc(file); c != EOF; c = fgetc(file)) bytes.push_back(c);
+	fclose(file);
+	return bytes;
+}
+
+void round_trip(std::vector<uint8_t>& bytes, BlockStreamOptions& options) {
+	write_file(IN_FILE, bytes);
+	BlockStreamStats stats;
+	assert(block_stream_encode(IN_FILE, ENC_FILE, options, stats) && "could not encode!");
+	assert(stats.inputSize == bytes.size() && "input size does not match!");
+	assert(stats.blockCount == (bytes.size() + options.blockSize - 1) / options.blockSize && "block count does not match!");
+	assert(block_stream_decode(ENC_FILE, OUT_FILE, options, stats) && "could not decode!");
+	assert(read_file(OUT_FILE) == bytes && "file does not match!");
+}
+
+int main() {
+	//Emitted in order, however the tasks finish
+	ThreadPool pool(3);
+	std::vector<int> order;
+	std::vector<int> slots(2);
+	thread_pool_run_ordered(pool, 100, 2, [&](int i) { slots[i % 2] = i; }, [&](int i) { order.push_back(slots[i % 2]); });
+	for (int i = 0; i < 100; i++) assert(order[i] == i && "out of order!");
+	cout << "Ordered OK" << endl;
+
+	//Text-like bytes, with a short last block
+	srand(23);
+	std::vector<uint8_t> bytes(FILE_SIZE);
+	for (int i = 0; i < FILE_SIZE; i++) {
+		bytes[i] = (rand()%4 == 0)? rand()%256 : 'a' + rand()%26;
+	}
+	BlockStreamOptions options;
+	options.blockSize = 47;
+	options.threads = 4;
+	options.window = 3;
+	options.verify = true;
+	round_trip(bytes, options);
+	cout << "Near OK" << endl;
+
+	options.engine = BLOCK_ENGINE_NEARER;
+	options.blockSize = 16;
+	options.kSearch = 3;
+	round_trip(bytes, options);
+	cout << "Nearer OK" << endl;
+
+	//Ranges straight from the index, (within a block, across blocks, and up to the end)
+	BlockStreamReader reader;
+	assert(block_stream_open(ENC_FILE, reader) && "could not open stream!");
+	assert(reader.footer->blockCount == (FILE_SIZE + 15) / 16 && "index does not match!");
+	for (int r = 0; r < 50; r++) {
+		uint64_t start = rand() % (FILE_SIZE+1);
+		uint64_t length = rand() % (FILE_SIZE - start + 1);
+		std::vector<uint8_t> range(length);
+		assert(block_stream_read(reader, start, length, options, range.data()) && "could not read range!");
+		assert(std::equal(range.begin(), range.end(), bytes.begin() + start) && "range does not match!");
+	}
+	uint8_t byte;
+	assert(!block_stream_read(reader, FILE_SIZE, 1, options, &byte) && "read past the end!");
+	block_stream_close(reader);
+	cout << "Ranges OK" << endl;
+
+	std::vector<uint8_t> empty;
+	round_trip(empty, options);
+	cout << "Empty OK" << endl;
+
+	//Anything that isn't a stream should be turned down
+	BlockStreamStats stats;
+	assert(!block_stream_decode(IN_FILE, OUT_FILE, options, stats) && "invalid stream was decoded!");
+	BlockStreamOptions bigK = options;
+	bigK.kSearch = BLOCK_MAX_K_SEARCH + 1;
+	assert(!block_stream_encode(IN_FILE, ENC_FILE, bigK, stats) && "K that doesn't fit the header was encoded!");
+	round_trip(bytes, options);
+	std::vector<uint8_t> corrupt = read_file(ENC_FILE);
+	corrupt[corrupt.size() - sizeof(BlockStreamFooter) - 3] ^= 0x5A; //In the index
+	write_file(ENC_FILE, corrupt);
+	assert(!block_stream_open(ENC_FILE, reader) && "corrupt index was opened!");
+	round_trip(bytes, options);
+	assert(block_stream_open(ENC_FILE, reader) && "could not open stream!");
+	uint64_t firstBlock = reader.index[0].offset;
+	block_stream_close(reader);
+	std::vector<uint8_t> badHeader = read_file(ENC_FILE);
+	StreamBlockHeader blockHeader;
+	std::copy(&badHeader[firstBlock], &badHeader[firstBlock] + sizeof(blockHeader), (uint8_t*)&blockHeader);
+	blockHeader.maxSym = 2; //Smaller than the payload bytes
+	std::copy((uint8_t*)&blockHeader, (uint8_t*)&blockHeader + sizeof(blockHeader), &badHeader[firstBlock]);
+	write_file(ENC_FILE, badHeader);
+	assert(block_stream_open(ENC_FILE, reader) && "could not open stream!"); //(The index is still fine)
+	assert(!block_stream_read(reader, 0, 1, options, &byte) && "corrupt block header was read!");
+	block_stream_close(reader);
+	assert(!block_stream_decode(ENC_FILE, OUT_FILE, options, stats) && "corrupt block header was decoded!");
+	round_trip(bytes, options);
+	std::vector<uint8_t> badPayload = read_file(ENC_FILE);
+	badPayload[firstBlock + sizeof(StreamBlockHeader)] ^= 0x5A;
+	write_file(ENC_FILE, badPayload);
+	assert(block_stream_open(ENC_FILE, reader) && "could not open stream!");
+	assert(!block_stream_read(reader, 0, 1, options, &byte) && "corrupt block payload was read!");
+	block_stream_close(reader);
+	assert(!block_stream_decode(ENC_FILE, OUT_FILE, options, stats) && "corrupt block payload was decoded!");
+	std::vector<uint8_t> farSeq = {200, 100}; //Ranks past 256, (every sequence of one symbol comes first)
+	std::vector<uint8_t> oneVal(1);
+	assert(!decode_block(farSeq, BLOCK_ENGINE_NEAR, BLOCK_SYMS, oneVal) && "rank past the block was decoded!");
+	assert(!decode_block(farSeq, BLOCK_ENGINE_NEARER, BLOCK_SYMS, oneVal) && "rank past the block was decoded!");
+	round_trip(bytes, options);
+	std::vector<uint8_t> truncated = read_file(ENC_FILE);
+	truncated.pop_back();
+	write_file(ENC_FILE, truncated);
+	assert(!block_stream_decode(ENC_FILE, OUT_FILE, options, stats) && "truncated stream was decoded!");
+	cout << "Invalid OK" << endl;
+
+	remove(IN_FILE);
+	remove(ENC_FILE);
+	remove(OUT_FILE);
+	return 0;
+}
\ No newline at end of file
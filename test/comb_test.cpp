@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
 
 #include "flint/fmpz.h"
 #include "flint/arith.h"
@@ -37,7 +38,7 @@ int main() {
 	cout << "Testing Big functions (but with small values):" << endl;
 	for (int r = 0; r < combs; r++) {
 		fmpz_set_ui(bigR, r);
-		std::vector<uint8_t> combVals(K);		
+		std::vector<int> combVals(K);		
 		comb_unrank(bigR, N, K, combVals);
 		
 		comb_rank(combVals, bigRank);
@@ -46,6 +47,52 @@ int main() {
 		cout << "Unranking: " << r << endl;		
 		printVector(combVals);
 	}
+	
+	//Native binomials, (the table and the 128-bit loop), against fmpz
+	fmpz_t binom;
+	fmpz_init(binom);
+	for (int n = 0; n <= 66; n++) { //C(67, 33) is the last that fits
+		for (int k = 0; k <= n; k++) {
+			fmpz_bin_uiui(binom, n, k);
+			assert(fmpz_equal_ui(binom, comb(n, k)) && "comb does not match!");
+		}
+	}
+	fmpz_clear(binom);
+	
+	//Big values, (long walks and gallops), checked against the sum of binomials
+	cout << "Testing Big functions:" << endl;
+	srand(17);
+	fmpz_t expected;
+	fmpz_t cmb;
+	fmpz_init(expected);
+	fmpz_init(cmb);
+	for (int n : {64, 500, 3000}) {
+		for (int k : {1, 7, n/3, n-1}) {
+			for (int trial = 0; trial < 20; trial++) {
+				//Random k-subset of [0, n), (in order)
+				std::vector<int> expectedVals;
+				for (int v = 0; v < n; v++) {
+					if (rand() % (n - v) < k - (int)expectedVals.size()) expectedVals.push_back(v);
+				}
+				fmpz_zero(expected);
+				for (int i = 0; i < k; i++) {
+					fmpz_bin_uiui(cmb, expectedVals[i], i+1);
+					fmpz_add(expected, expected, cmb);
+				}
+				
+				fmpz_set(bigR, expected);
+				std::vector<int> combVals(k);
+				comb_unrank(bigR, n, k, combVals);
+				assert(combVals == expectedVals && "unrank does not match!");
+				
+				comb_rank(combVals, bigRank);
+				assert(fmpz_equal(bigRank, expected) && "rank does not match!");
+			}
+			cout << "N: " << n << ", K: " << k << " OK" << endl;
+		}
+	}
+	fmpz_clear(cmb);
+	fmpz_clear(expected);
 	fmpz_clear(bigR);
 	fmpz_clear(bigRank);
 	
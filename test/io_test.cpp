@@ -0,0 +1,139 @@
+#include <iostream>
+#include <cstdint>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "flint/fmpz.h"
+#include "flint/fmpz_mat.h"
+#include "../lib/io_lib.h"
+#include "../lib/rgf.h"
+#include "../lib/base_lib.h"
+
+using std::cout, std::endl;
+
+
+const int N = 300;
+const int K = 5;
+const char* DIR = "/tmp";
+const int RANK_LEN = 100;
+const int RANK_SYMS = 16;
+const int RANK_COUNT = 20;
+
+
+
+int main() {
+	
+	//Round trip a table through the store
+	fmpz_mat_t table;
+	gen_rgf_table(N, K, table);
+	fmpz_set_si(fmpz_mat_entry(table, 1, 0), -7); //Make sure signs survive, (and small values)
+	std::string path = table_store_path(DIR, N, K, TABLE_ENGINE_RGF_TABLE);
+	assert(table_store_write(path.c_str(), table, N, K, TABLE_ENGINE_RGF_TABLE) && "could not write table!");
+	
+	TableStore store;
+	assert(table_store_open(path.c_str(), store) && "could not open table!");
+	assert(store.header->n == N && store.header->k == K && "key does not match!");
+	
+	fmpz_mat_t loaded;
+	table_store_get_mat(store, loaded);
+	assert(fmpz_mat_equal(table, loaded) && "table does not match!");
+	
+	mpz_t view;
+	fmpz_t entry;
+	fmpz_init(entry);
+	fmpz_set_mpz(entry, table_store_entry(store, N, 1, view));
+	assert(fmpz_equal(entry, fmpz_mat_entry(table, N, 1)) && "entry does not match!");
+	fmpz_clear(entry);
+	table_store_close(store);
+	fmpz_mat_clear(loaded);
+	
+	//Any corruption should fail the checksum
+	FILE* file = fopen(path.c_str(), "r+b");
+	fseek(file, -3, SEEK_END);
+	fputc(0x5A, file);
+	fclose(file);
+	assert(!table_store_open(path.c_str(), store, true) && "corrupt table was opened!");
+	
+	//An entry past the limbs is turned down even without the checksum
+	assert(table_store_write(path.c_str(), table, N, K, TABLE_ENGINE_RGF_TABLE) && "could not write table!");
+	long count = (N+1) * (K+2);
+	uint64_t badOffset = UINT64_MAX - 1;
+	file = fopen(path.c_str(), "r+b");
+	fseek(file, sizeof(TableStoreHeader) + (2*count - 1) * sizeof(uint64_t), SEEK_SET);
+	fwrite(&badOffset, sizeof(badOffset), 1, file);
+	fclose(file);
+	assert(!table_store_open(path.c_str(), store) && "entry past the limbs was opened!");
+	remove(path.c_str());
+	
+	//Stored rows should match generated rows
+	fmpz_mat_t row;
+	fmpz_mat_t storedRow;
+	gen_rgf_row(N, K, row);
+	load_rgf_row(DIR, N, K, storedRow); //Generates and stores
+	fmpz_mat_clear(storedRow);
+	load_rgf_row(DIR, N, K, storedRow); //Loads
+	assert(fmpz_mat_equal(row, storedRow) && "stored row does not match!");
+	fmpz_mat_clear(storedRow);
+	
+	//A corrupt stored row is turned down, and generated again
+	std::string rowPath = table_store_path(DIR, N, K, TABLE_ENGINE_RGF_ROW);
+	file = fopen(rowPath.c_str(), "r+b");
+	fseek(file, -3, SEEK_END);
+	fputc(0x5A, file);
+	fclose(file);
+	assert(!load_rgf_stored(DIR, N, K, TABLE_ENGINE_RGF_ROW, storedRow) && "corrupt row was loaded!");
+	load_rgf_row(DIR, N, K, storedRow); //Generates and stores again
+	assert(fmpz_mat_equal(row, storedRow) && "regenerated row does not match!");
+	fmpz_mat_clear(storedRow);
+	assert(load_rgf_stored(DIR, N, K, TABLE_ENGINE_RGF_ROW, storedRow) && "regenerated row was not stored!");
+	assert(fmpz_mat_equal(row, storedRow) && "stored row does not match!");
+	remove(rowPath.c_str());
+	cout << "Table store OK" << endl;
+	
+	fmpz_mat_clear(storedRow);
+	fmpz_mat_clear(row);
+	fmpz_mat_clear(table);
+	
+	//Ranks at their minimal width, (16^100 is exactly 400 bits, so 7 limbs)
+	assert(rank_bits(RANK_LEN, RANK_SYMS) == 400 && "rank bits do not match!");
+	assert(rank_width(RANK_LEN, RANK_SYMS) == 7 && "rank width does not match!");
+	assert(rank_bits(1, 2) == 1 && rank_width(1, 1) == 1 && "small rank width does not match!");
+	int width = rank_width(RANK_LEN, RANK_SYMS);
+	srand(25);
+	fmpz* ranks = _fmpz_vec_init(RANK_COUNT);
+	std::string rankPath = std::string(DIR) + "/decimate_ranks";
+	file = fopen(rankPath.c_str(), "wb");
+	for (int r = 0; r < RANK_COUNT; r++) {
+		std::vector<uint8_t> seq(RANK_LEN);
+		for (int i = 0; i < RANK_LEN; i++) seq[i] = (r == RANK_COUNT-1)? RANK_SYMS-1 : rand()%RANK_SYMS; //(Largest rank last)
+		std::vector<int> counts(RANK_SYMS);
+		if (r > 0) b2n(seq, RANK_SYMS, counts, ranks + r); //(Zero first)
+		assert(rank_write(file, ranks + r, width) && "could not write rank!");
+	}
+	fclose(file);
+	
+	//Back in place, straight out of the file
+	file = fopen(rankPath.c_str(), "rb");
+	std::vector<mp_limb_t> limbs(RANK_COUNT * width);
+	assert(fread(limbs.data(), sizeof(mp_limb_t), limbs.size(), file) == limbs.size() && "rank file size does not match!");
+	assert(fgetc(file) == EOF && "rank file size does not match!");
+	fclose(file);
+	remove(rankPath.c_str());
+	fmpz_t viewed;
+	fmpz_t unpacked;
+	fmpz_init(viewed);
+	fmpz_init(unpacked);
+	for (int r = 0; r < RANK_COUNT; r++) {
+		fmpz_set_mpz(viewed, rank_view(&limbs[r * width], width, view));
+		assert(fmpz_equal(viewed, ranks + r) && "rank view does not match!");
+		rank_unpack(&limbs[r * width], width, unpacked);
+		assert(fmpz_equal(unpacked, ranks + r) && "rank does not match!");
+	}
+	fmpz_clear(viewed);
+	fmpz_clear(unpacked);
+	_fmpz_vec_clear(ranks, RANK_COUNT);
+	cout << "Rank codec OK" << endl;
+	return 0;
+}
\ No newline at end of file
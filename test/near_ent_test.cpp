@@ -12,6 +12,20 @@ using std::cout, std::endl;
 
 const int MAX_SYM = 5;
 const int SEQ_LEN = 3;
+const int BYTE_SEQ_LEN = 300;
+
+bool unranks_within(std::vector<uint8_t>& seq, int maxSym, double maxEntropy) {
+	//Ranks seq, and unranks it again under the entropy bound
+	fmpz_t rank;
+	fmpz_init(rank);
+	near_entropic_rank(seq, maxSym, rank);
+	std::vector<uint8_t> decoded(seq.size());
+	std::vector<int> counts(maxSym);
+	bool completed = near_entropic_unrank(rank, seq.size(), maxSym, counts, decoded, maxEntropy);
+	fmpz_clear(rank);
+	assert((!completed || decoded == seq) && "bounded seq does not match!");
+	return completed;
+}
 
 int main() {
 		
@@ -41,7 +55,123 @@ int main() {
 		
 	}
 	
-		
+	//Raw bytes, (every byte value appears, so the RGF digits run up to 256), and a wider alphabet
+	std::vector<uint8_t> bytes(BYTE_SEQ_LEN);
+	for (int i = 0; i < BYTE_SEQ_LEN; i++) bytes[i] = (i < 256)? 255-i : rand() % 256;
+	fmpz_t byteRank;
+	fmpz_init(byteRank);
+	near_entropic_rank(bytes, 256, byteRank);
+	std::vector<uint8_t> decodedBytes(BYTE_SEQ_LEN);
+	std::vector<int> byteCounts(256);
+	near_entropic_unrank(byteRank, BYTE_SEQ_LEN, 256, byteCounts, decodedBytes);
+	assert(decodedBytes == bytes && "byte seq does not match!");
+	
+	std::vector<uint16_t> wide(BYTE_SEQ_LEN);
+	for (int i = 0; i < BYTE_SEQ_LEN; i++) wide[i] = rand() % 1000;
+	near_entropic_rank(wide, 1000, byteRank);
+	std::vector<uint16_t> decodedWide(BYTE_SEQ_LEN);
+	std::vector<int> wideCounts(1000);
+	near_entropic_unrank(byteRank, BYTE_SEQ_LEN, 1000, wideCounts, decodedWide);
+	assert(decodedWide == wide && "wide seq does not match!");
+	fmpz_clear(byteRank);
+	cout << "Byte and wide seqs OK" << endl;
+	
+	//Native widths against the fmpz path, (64, 128, and 256 bit blocks)
+	for (int nativeLen: {15, 30, 60}) {
+		for (int trial = 0; trial < 20; trial++) {
+			std::vector<uint8_t> seq(nativeLen);
+			int nativeMaxSym = 16;
+			for (int i = 0; i < nativeLen; i++) seq[i] = rand() % (1 + trial % nativeMaxSym);
+			fmpz_t nativeRank;
+			fmpz_t slowRank;
+			fmpz_init(nativeRank);
+			fmpz_init(slowRank);
+			near_entropic_rank(seq, nativeMaxSym, nativeRank);
+			set_native_engine(false);
+			near_entropic_rank(seq, nativeMaxSym, slowRank);
+			set_native_engine(true);
+			assert(fmpz_equal(nativeRank, slowRank) && "native rank does not match!");
+			
+			std::vector<uint8_t> decoded(nativeLen);
+			std::vector<int> nativeCounts(nativeMaxSym);
+			bool completed = near_entropic_unrank(nativeRank, nativeLen, nativeMaxSym, nativeCounts, decoded);
+			assert(completed && decoded == seq && "native seq does not match!");
+			
+			//The entropy bound has to agree too
+			double entropy = 0.0;
+			for (int c: nativeCounts) if (c > 0) entropy -= c * std::log2((double)c / nativeLen);
+			std::vector<int> boundCounts(nativeMaxSym);
+			assert(near_entropic_unrank(slowRank, nativeLen, nativeMaxSym, boundCounts, decoded, entropy) && "native bound is too tight!");
+			near_entropic_rank(seq, nativeMaxSym, slowRank);
+			std::vector<int> tightCounts(nativeMaxSym);
+			assert((entropy < 0.5 || !near_entropic_unrank(slowRank, nativeLen, nativeMaxSym, tightCounts, decoded, entropy - 0.5)) && "native bound is too loose!");
+			fmpz_clear(nativeRank);
+			fmpz_clear(slowRank);
+		}
+		cout << "Native Len: " << nativeLen << " OK" << endl;
+	}
+	
+	//More block sizes than the per-thread table cache holds, round and round
+	for (int trial = 0; trial < 60; trial++) {
+		int cycleLen = 10 + trial % 12;
+		int cycleMaxSym = 4 + trial % 3;
+		std::vector<uint8_t> seq(cycleLen);
+		for (int i = 0; i < cycleLen; i++) seq[i] = rand() % cycleMaxSym;
+		fmpz_t cycleRank;
+		fmpz_init(cycleRank);
+		near_entropic_rank(seq, cycleMaxSym, cycleRank);
+		std::vector<uint8_t> decoded(cycleLen);
+		std::vector<int> cycleCounts(cycleMaxSym);
+		near_entropic_unrank(cycleRank, cycleLen, cycleMaxSym, cycleCounts, decoded);
+		assert(decoded == seq && "cached table seq does not match!");
+		fmpz_clear(cycleRank);
+	}
+	cout << "Native cache OK" << endl;
+	
+	//Entropy bounds through the fmpz path, (the native engine is off), and past the native alphabet
+	set_native_engine(false);
+	for (int boundMaxSym: {4, 16, 24, 256}) {
+		for (int boundLen: {20, 90}) {
+			for (int trial = 0; trial < 10; trial++) {
+				int used = 1 + rand() % boundMaxSym;
+				std::vector<uint8_t> seq(boundLen);
+				std::vector<int> counts(boundMaxSym);
+				for (int i = 0; i < boundLen; i++) {
+					seq[i] = rand() % used;
+					counts[seq[i]]++;
+				}
+				double entropy = measureEntropy(counts, boundLen);
+				assert(unranks_within(seq, boundMaxSym, entropy) && "bound is too tight!");
+				assert((entropy < 0.5 || !unranks_within(seq, boundMaxSym, entropy - 0.5)) && "bound is too loose!");
+			}
+		}
+		cout << "Bound, Max Sym: " << boundMaxSym << " OK" << endl;
+	}
+	set_native_engine(true);
+	
+	//Batches, (structure-of-arrays, with a tail that doesn't fill the lanes)
+	const int BATCH_COUNT = 37;
+	const int BATCH_LEN = 15;
+	std::vector<uint8_t> batch(BATCH_COUNT*BATCH_LEN);
+	for (int r = 0; r < BATCH_COUNT; r++) {
+		for (int i = 0; i < BATCH_LEN; i++) batch[i*BATCH_COUNT + r] = rand() % (1 + r % 16);
+	}
+	std::vector<uint64_t> batchRanks(BATCH_COUNT);
+	assert(near_rank_batch(batch.data(), BATCH_COUNT, BATCH_LEN, 16, batchRanks.data()) && "batch should fit in 64 bits!");
+	for (int r = 0; r < BATCH_COUNT; r++) {
+		std::vector<uint8_t> seq(BATCH_LEN);
+		for (int i = 0; i < BATCH_LEN; i++) seq[i] = batch[i*BATCH_COUNT + r];
+		fmpz_t seqRank;
+		fmpz_init(seqRank);
+		near_entropic_rank(seq, 16, seqRank);
+		assert(fmpz_equal_ui(seqRank, batchRanks[r]) && "batch rank does not match!");
+		fmpz_clear(seqRank);
+	}
+	std::vector<uint8_t> batchDecoded(BATCH_COUNT*BATCH_LEN);
+	near_unrank_batch(batchRanks.data(), BATCH_COUNT, BATCH_LEN, 16, batchDecoded.data());
+	assert(batchDecoded == batch && "batch seqs do not match!");
+	assert(!near_rank_batch(batch.data(), BATCH_COUNT, BATCH_LEN, 20, batchRanks.data()) && "batch should not fit in 64 bits!");
+	cout << "Batch OK" << endl;
 	
 	return 0;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include "flint/fmpz.h"
 #include "flint/arith.h"
 #include "../lib/nearer_entropic.h"
@@ -12,6 +13,20 @@ using std::cout, std::endl;
 
 const int SEQ_LEN = 5;
 const int MAX_SYM = 3;
+const int LONG_SEQ_LEN = 600;
+
+bool unranks_within(std::vector<uint8_t>& seq, int maxSym, double maxEntropy) {
+	//Ranks seq, and unranks it again under the entropy bound
+	fmpz_t rank;
+	fmpz_init(rank);
+	nearer_entropic_rank(seq, maxSym, rank);
+	std::vector<uint8_t> decoded(seq.size());
+	std::vector<int> counts(maxSym);
+	bool completed = nearer_entropic_unrank(rank, seq.size(), maxSym, counts, decoded, maxEntropy);
+	fmpz_clear(rank);
+	assert((!completed || decoded == seq) && "bounded seq does not match!");
+	return completed;
+}
 
 int main() {
 	/*
@@ -65,6 +80,64 @@ int main() {
 		
 	}
 	
+	//Long enough that the parts are ranked in parallel
+	srand(5);
+	for (int maxSym : {2, 5, 16}) {
+		std::vector<uint8_t> seq(LONG_SEQ_LEN);
+		for (int i = 0; i < LONG_SEQ_LEN; i++) seq[i] = rand() % maxSym;
+		
+		fmpz_t entRank;	
+		fmpz_init(entRank);
+		nearer_entropic_rank(seq, maxSym, entRank);
+		
+		std::vector<uint8_t> decoded(LONG_SEQ_LEN);
+		std::vector<int> counts(maxSym);
+		nearer_entropic_unrank(entRank, LONG_SEQ_LEN, maxSym, counts, decoded);
+		assert(decoded == seq && "long seq does not match!");
+		fmpz_clear(entRank);
+		cout << "Long Seq, Max Sym: " << maxSym << " OK" << endl;
+	}
+	
+	//Raw bytes, (every byte value appears), and a wider alphabet
+	std::vector<uint8_t> bytes(LONG_SEQ_LEN);
+	for (int i = 0; i < LONG_SEQ_LEN; i++) bytes[i] = (i < 256)? 255-i : rand() % 256;
+	fmpz_t byteRank;
+	fmpz_init(byteRank);
+	nearer_entropic_rank(bytes, 256, byteRank);
+	std::vector<uint8_t> decodedBytes(LONG_SEQ_LEN);
+	std::vector<int> byteCounts(256);
+	nearer_entropic_unrank(byteRank, LONG_SEQ_LEN, 256, byteCounts, decodedBytes);
+	assert(decodedBytes == bytes && "byte seq does not match!");
+	
+	std::vector<uint16_t> wide(LONG_SEQ_LEN);
+	for (int i = 0; i < LONG_SEQ_LEN; i++) wide[i] = rand() % 1000;
+	nearer_entropic_rank(wide, 1000, byteRank);
+	std::vector<uint16_t> decodedWide(LONG_SEQ_LEN);
+	std::vector<int> wideCounts(1000);
+	nearer_entropic_unrank(byteRank, LONG_SEQ_LEN, 1000, wideCounts, decodedWide);
+	assert(decodedWide == wide && "wide seq does not match!");
+	fmpz_clear(byteRank);
+	cout << "Byte and wide seqs OK" << endl;
+	
+	//Entropy bounds, (a sequence always fits its own entropy, and never anything below it)
+	for (int boundMaxSym: {3, 16, 24, 256}) {
+		for (int boundLen: {20, 90}) {
+			for (int trial = 0; trial < 10; trial++) {
+				int used = 1 + rand() % boundMaxSym;
+				std::vector<uint8_t> seq(boundLen);
+				std::vector<int> counts(boundMaxSym);
+				for (int i = 0; i < boundLen; i++) {
+					seq[i] = rand() % used;
+					counts[seq[i]]++;
+				}
+				double entropy = measureEntropy(counts, boundLen);
+				assert(unranks_within(seq, boundMaxSym, entropy) && "bound is too tight!");
+				assert((entropy < 0.5 || !unranks_within(seq, boundMaxSym, entropy - 0.5)) && "bound is too loose!");
+			}
+		}
+		cout << "Bound, Max Sym: " << boundMaxSym << " OK" << endl;
+	}
+	
 		
 	
 	return 0;
@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <vector>
 #include <cassert>
+#include <cstdlib>
 
 #include "flint/fmpz.h"
 #include "flint/arith.h"
@@ -52,7 +53,34 @@ int main() {
 		
 		fmpz_clear(rank);
 	}
-		
+	
+	//The native path should match the recursive one, (which is what the fmpz versions use past SMALL_SYM_MAX)
+	srand(9);
+	for (int n = 0; n <= SMALL_SYM_MAX; n++) {
+		assert(FACTS.f[n] == factorial(n) && "factorial table does not match!");
+		for (int trial = 0; trial < 50; trial++) {
+			uint64_t r = n == 0? 0 : (((uint64_t)rand() << 32) ^ rand()) % FACTS.f[n];
+			fmpz_t bigR;
+			fmpz_init(bigR);
+			fmpz_set_ui(bigR, r);
+			std::vector<uint8_t> perm(n);
+			for (int i = 0; i < n; i++) perm[i] = i;
+			myrvold_unrank_recur(bigR, n, perm);
+			
+			std::vector<uint8_t> nativePerm(n);
+			myrvold_unrank_ui(r, nativePerm);
+			assert(nativePerm == perm && "native unrank does not match!");
+			
+			std::vector<uint8_t> invPerm(n);
+			for (int i = 0; i < n; i++) invPerm[perm[i]] = i;
+			std::vector<uint8_t> permCopy = perm;
+			fmpz_zero(bigR);
+			myrvold_rank_recur(n, permCopy, invPerm, bigR);
+			assert(fmpz_equal_ui(bigR, r) && myrvold_rank_ui(perm) == r && "native rank does not match!");
+			fmpz_clear(bigR);
+		}
+	}
+	cout << "Native OK" << endl;
 	
 	return 0;
 }
\ No newline at end of file
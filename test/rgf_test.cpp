@@ -13,8 +13,33 @@ using std::cout, std::endl;
 
 const int N = 5;
 const int K =3;
+const int DC_N = 3000; //Long enough to split into halves
+const int DC_K = 7;
+const int DC_LATE_N = 1500;
+const int DC_LATE_K = 20; //(RGF_DC_MAX_K)
 
 
+void check_dc(fmpz_t rank, int n, int k, fmpz_mat_t table) {
+	//Divide-and-conquer unranking should match the stepwise unranking, and rank back the same both ways
+	fmpz_t dcRank;
+	fmpz_t stepRank;
+	fmpz_init(dcRank);
+	fmpz_init(stepRank);
+	fmpz_set(dcRank, rank);
+	fmpz_set(stepRank, rank);
+	std::vector<uint8_t> dcSeq(n);
+	std::vector<uint8_t> stepSeq(n);
+	rgf_unrank_dc(dcRank, n, k, dcSeq);
+	rgf_unrank_table(stepRank, n, k, table, stepSeq);
+	assert(dcSeq == stepSeq && "D&C unrank does not match!");
+	
+	rgf_rank_dc(dcSeq, k, dcRank);
+	assert(fmpz_equal(dcRank, rank) && "D&C rank does not match!");
+	rgf_rank(dcSeq, k, dcRank);
+	assert(fmpz_equal(dcRank, rank) && "rank does not match!");
+	fmpz_clear(stepRank);
+	fmpz_clear(dcRank);
+}
 
 int main() {
 		
@@ -43,6 +68,44 @@ int main() {
 		assert(fmpz_equal_ui(rank, r) && "rank does not match!");				
 		fmpz_clear(rank);
 	}
+	
+	//Divide-and-conquer, (the late k saturates right at the end for the lowest ranks, and the last ranks run off the end of each first half)
+	for (int dcK: {DC_K, DC_LATE_K}) {
+		int dcN = (dcK == DC_K)? DC_N : DC_LATE_N;
+		fmpz_mat_t table;
+		gen_rgf_table(dcN, dcK, table);
+		fmpz_t dcTotal;
+		fmpz_t rank;
+		fmpz_init(dcTotal);
+		fmpz_init(rank);
+		arith_stirling_number_2(dcTotal, dcN, dcK);
+		for (int i = 0; i < 10; i++) {
+			fmpz_tdiv_q_ui(rank, dcTotal, 10);
+			fmpz_mul_ui(rank, rank, i);
+			fmpz_add_ui(rank, rank, i);
+			check_dc(rank, dcN, dcK, table);
+		}
+		for (int i = 1; i <= 2; i++) {
+			fmpz_set_ui(rank, i-1);
+			check_dc(rank, dcN, dcK, table);
+			fmpz_sub_ui(rank, dcTotal, i);
+			check_dc(rank, dcN, dcK, table);
+		}
+		
+		//Hardly any guard bits, so the first halves are off by more than a step, and most fall back to stepwise
+		int guard = get_rgf_dc_guard();
+		set_rgf_dc_guard(-dcN/2);
+		for (int i = 1; i < 4; i++) {
+			fmpz_tdiv_q_ui(rank, dcTotal, 4);
+			fmpz_mul_ui(rank, rank, i);
+			check_dc(rank, dcN, dcK, table);
+		}
+		set_rgf_dc_guard(guard);
+		fmpz_clear(rank);
+		fmpz_clear(dcTotal);
+		fmpz_mat_clear(table);
+		cout << "D&C, K: " << dcK << " OK" << endl;
+	}
 		
 	
 	return 0;
@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <vector>
 #include <cassert>
+#include <thread>
 
 #include "flint/fmpz.h"
 #include "flint/arith.h"
@@ -11,16 +12,98 @@
 using std::cout, std::endl;
 
 
-const int N = 6;
-const int K = 3;
-const int M = 2;
-
+const int N = 20;
+const int EGF_N = 300;
+const int EGF_K = 12; //(K-1, K and K+1 all need the same number of primes)
+const int EGF_M = 40;
+const int EGF_R = 25;
 
 
 
 int main() {
 	
-	gen_coeff_table(N, K, M);
-	cout << "Generating - N: " << N << ", K: " << K << ", M: " << M << endl;
+	//The multi-modular and table counts should match the rational ones exactly
+	fmpz_mat_t kFacts;
+	gen_k_facts(N, kFacts);
+	fmpq_mat_t coeffs;
+	gen_coeffs(N, coeffs);
+	
+	fmpz_t nFact;
+	fmpz_t prevNFact;
+	fmpz_t expected;
+	fmpz_t count;
+	fmpz_init(nFact);
+	fmpz_init(prevNFact);
+	fmpz_init(expected);
+	fmpz_init(count);
+	for (int n = 1; n <= N; n++) {
+		fmpz_fac_ui(nFact, n);
+		fmpz_fac_ui(prevNFact, n-1);
+		for (int k = 1; k <= n; k++) {
+			fmpz* kFact = fmpz_mat_entry(kFacts, 0, k);
+			fmpz* prevKFact = fmpz_mat_entry(kFacts, 0, k-1);
+			for (int m = 1; m <= n-k+1; m++) {
+				stirling2_max_lt_fmpq(n, k, m, nFact, kFact, coeffs, expected);
+				stirling2_max_lt_nmod(n, k, m, nFact, kFact, count);
+				assert(fmpz_equal(count, expected) && "max count does not match!");
+				bool tabled = stirling2_max_lt_table(n, k, m, count);
+				assert(tabled && "table too big!");
+				assert(fmpz_equal(count, expected) && "max table count does not match!");
+				
+				//(n-1)! / (k-1)!, as nearer_entropic uses it
+				for (int r = 1; r <= m; r++) {
+					stirling2_max_initial_lt_fmpq(n, k, m, r, prevNFact, prevKFact, coeffs, expected);
+					stirling2_max_initial_lt_nmod(n, k, m, r, prevNFact, prevKFact, count);
+					assert(fmpz_equal(count, expected) && "initial count does not match!");
+					tabled = stirling2_max_initial_lt_table(n, k, m, r, count);
+					assert(tabled && "table too big!");
+					assert(fmpz_equal(count, expected) && "initial table count does not match!");
+				}
+			}
+		}
+	}
+	cout << "Counts OK" << endl;
+	
+	//The EGF power cache is per thread, so a new thread starts it empty.  A^K is made with nmod_poly_pow_trunc, then A^(K-1) 
+	//for the initial count is divided out of it, (nmod_poly_div_series), and A^(K+1) multiplied on, (nmod_poly_mullow).
+	//Each should match the same count made alone on a fresh thread, (straight from nmod_poly_pow_trunc), and the rationals
+	fmpz_mat_t egfKFacts;
+	fmpq_mat_t egfCoeffs;
+	gen_k_facts(EGF_K+1, egfKFacts);
+	gen_coeffs(EGF_N, egfCoeffs);
+	fmpz_fac_ui(nFact, EGF_N);
+	fmpz_fac_ui(prevNFact, EGF_N-1);
+	auto egfCount = [&](int which, fmpz_t countOut) {
+		if (which == 0) stirling2_max_lt_nmod(EGF_N, EGF_K, EGF_M, nFact, fmpz_mat_entry(egfKFacts, 0, EGF_K), countOut);
+		else if (which == 1) stirling2_max_initial_lt_nmod(EGF_N, EGF_K, EGF_M, EGF_R, prevNFact, fmpz_mat_entry(egfKFacts, 0, EGF_K-1), countOut);
+		else stirling2_max_lt_nmod(EGF_N, EGF_K+1, EGF_M, nFact, fmpz_mat_entry(egfKFacts, 0, EGF_K+1), countOut);
+	};
+	fmpz* stepped = _fmpz_vec_init(3);
+	fmpz* direct = _fmpz_vec_init(3);
+	std::thread([&]() { 
+		for (int which = 0; which < 3; which++) egfCount(which, stepped + which);
+	}).join();
+	for (int which = 0; which < 3; which++) {
+		std::thread([&]() { egfCount(which, direct + which); }).join();
+	}
+	stirling2_max_lt_fmpq(EGF_N, EGF_K, EGF_M, nFact, fmpz_mat_entry(egfKFacts, 0, EGF_K), egfCoeffs, expected);
+	assert(fmpz_equal(stepped, expected) && fmpz_equal(direct, expected) && "max count does not match!");
+	stirling2_max_initial_lt_fmpq(EGF_N, EGF_K, EGF_M, EGF_R, prevNFact, fmpz_mat_entry(egfKFacts, 0, EGF_K-1), egfCoeffs, expected);
+	assert(fmpz_equal(stepped + 1, expected) && fmpz_equal(direct + 1, expected) && "divided out count does not match!");
+	stirling2_max_lt_fmpq(EGF_N, EGF_K+1, EGF_M, nFact, fmpz_mat_entry(egfKFacts, 0, EGF_K+1), egfCoeffs, expected);
+	assert(fmpz_equal(stepped + 2, expected) && fmpz_equal(direct + 2, expected) && "multiplied on count does not match!");
+	assert(!fmpz_is_zero(stepped + 1) && !fmpz_is_zero(stepped + 2) && "counts should not be empty!");
+	_fmpz_vec_clear(stepped, 3);
+	_fmpz_vec_clear(direct, 3);
+	fmpq_mat_clear(egfCoeffs);
+	fmpz_mat_clear(egfKFacts);
+	cout << "EGF powers OK" << endl;
+	
+	fmpz_clear(count);
+	fmpz_clear(expected);
+	fmpz_clear(prevNFact);
+	fmpz_clear(nFact);
+	fmpq_mat_clear(coeffs);
+	fmpz_mat_clear(kFacts);
 	return 0;
 }
\ No newline at end of file